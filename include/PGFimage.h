@@ -46,7 +46,7 @@ class CWaveletTransform;
 ///		GetBitmap()
 /// Encoding:
 ///		SetHeader()
-///		ImportBitmap()
+///		ImportBitmap() or BeginImport(), ImportRows(), EndImport()
 ///		Write()
 /// @author C. Stamm, R. Spuler
 /// @brief PGF main class
@@ -120,7 +120,7 @@ public:
 	//////////////////////////////////////////////////////////////////////
 	/// Get image data in interleaved format: (ordering of RGB data is BGR[A])
 	/// Upsampling, YUV to RGB transform and interleaving are done here to reduce the number
-	/// of passes over the data.
+	/// of passes over the data. If Open MP is used in the decoder, bands of rows are converted in parallel.
 	/// The absolute value of pitch is the number of bytes of an image row of the given image buffer.
 	/// If pitch is negative, then the image buffer must point to the last row of a bottom-up image (first byte on last row).
 	/// if pitch is positive, then the image buffer must point to the first row of a top-down image (first byte).
@@ -132,10 +132,26 @@ public:
 	/// @param buff An image buffer.
 	/// @param bpp The number of bits per pixel used in image buffer.
 	/// @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
-	/// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
+	/// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row, or after each band of rows if Open MP is used. If cb returns true, then it stops proceeding.
 	/// @param data Data Pointer to C++ class container to host callback procedure.
 	void GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] = nullptr, CallbackPtr cb = nullptr, void *data = nullptr) const; // throws IOException
 
+	//////////////////////////////////////////////////////////////////////
+	/// Get a band of rows of the image in interleaved format (see GetBitmap).
+	/// Only the rows [firstRow, firstRow + nRows) of the image are written into the buffer,
+	/// hence a large image can be passed on band by band through a small buffer.
+	/// Rows below the last row of the image are ignored.
+	/// It might throw an IOException.
+	/// @param firstRow The index of the first row to copy (top-down)
+	/// @param nRows The number of rows to copy
+	/// @param pitch The number of bytes of a row of the image buffer.
+	/// @param buff An image buffer of at least nRows rows.
+	/// @param bpp The number of bits per pixel used in image buffer.
+	/// @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
+	/// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
+	/// @param data Data Pointer to C++ class container to host callback procedure.
+	void GetBitmapRows(UINT32 firstRow, UINT32 nRows, int pitch, UINT8* buff, BYTE bpp, int channelMap[] = nullptr, CallbackPtr cb = nullptr, void *data = nullptr) const; // throws IOException
+
 	//////////////////////////////////////////////////////////////////////
 	/// Get YUV image data in interleaved format: (ordering is YUV[A])
 	/// The absolute value of pitch is the number of bytes of an image row of the given image buffer.
@@ -153,6 +169,21 @@ public:
 	/// @param data Data Pointer to C++ class container to host callback procedure.
 	void GetYUV(int pitch, DataT* buff, BYTE bpp, int channelMap[] = nullptr, CallbackPtr cb = nullptr, void *data = nullptr) const; // throws IOException
 
+	//////////////////////////////////////////////////////////////////////
+	/// Get a band of rows of the YUV image in interleaved format (see GetYUV).
+	/// Only the rows [firstRow, firstRow + nRows) of the image are written into the buffer.
+	/// Rows below the last row of the image are ignored.
+	/// It might throw an IOException.
+	/// @param firstRow The index of the first row to copy (top-down)
+	/// @param nRows The number of rows to copy
+	/// @param pitch The number of bytes of a row of the image buffer.
+	/// @param buff An image buffer of at least nRows rows.
+	/// @param bpp The number of bits per pixel used in image buffer.
+	/// @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
+	/// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
+	/// @param data Data Pointer to C++ class container to host callback procedure.
+	void GetYUVRows(UINT32 firstRow, UINT32 nRows, int pitch, DataT* buff, BYTE bpp, int channelMap[] = nullptr, CallbackPtr cb = nullptr, void *data = nullptr) const; // throws IOException
+
 	//////////////////////////////////////////////////////////////////////
 	/// Import an image from a specified image buffer.
 	/// This method is usually called before Write(...) and after SetHeader(...).
@@ -171,6 +202,33 @@ public:
 	/// @param data Data Pointer to C++ class container to host callback procedure.
 	void ImportBitmap(int pitch, UINT8 *buff, BYTE bpp, int channelMap[] = nullptr, CallbackPtr cb = nullptr, void *data = nullptr);
 
+	//////////////////////////////////////////////////////////////////////
+	/// Start a streaming import of an image.
+	/// Call this method after SetHeader(...) instead of ImportBitmap(...), then pass all image rows
+	/// in top-down order with ImportRows(...) and finish with EndImport().
+	/// The rows are converted to YUV as they arrive and immediately wavelet transformed, hence the
+	/// image is never kept at full size in memory. The encoded image is the same as with ImportBitmap(...).
+	/// It might throw an IOException.
+	/// @param bpp The number of bits per pixel used in the image rows.
+	/// @param channelMap A integer array containing the mapping of input channel ordering to expected channel ordering (see ImportBitmap).
+	void BeginImport(BYTE bpp, int channelMap[] = nullptr);
+
+	//////////////////////////////////////////////////////////////////////
+	/// Import the next rows of a streaming import (see BeginImport).
+	/// The absolute value of pitch is the number of bytes of an image row.
+	/// If pitch is negative, then buff points to the last of the given rows in a bottom-up buffer (first byte on last row).
+	/// If pitch is positive, then buff points to the first of the given rows in a top-down buffer (first byte).
+	/// It might throw an IOException.
+	/// @param pitch The number of bytes of a row of the image buffer.
+	/// @param buff An image buffer containing nRows rows.
+	/// @param nRows The number of rows
+	void ImportRows(int pitch, UINT8 *buff, UINT32 nRows);
+
+	//////////////////////////////////////////////////////////////////////
+	/// Finish a streaming import (see BeginImport).
+	/// It throws an IOException with MissingData, if not all rows of the image have been imported.
+	void EndImport();
+
 	//////////////////////////////////////////////////////////////////////
 	/// Import a YUV image from a specified image buffer.
 	/// The absolute value of pitch is the number of bytes of an image row.
@@ -246,9 +304,17 @@ public:
 	/////////////////////////////////////////////////////////////////////
 	/// Configures the encoder.
 	/// @param useOMP Use parallel threading with Open MP during encoding. Default value: true. Influences the encoding only if the codec has been compiled with OpenMP support.
-	/// @param favorSpeedOverSize Favors encoding speed over compression ratio. Default value: false
+	/// @param favorSpeedOverSize Favors encoding speed over compression ratio. Default value: false.
+	///               It takes precedence over the effort level: if true, the encoder effort level (see SetEncoderEffort) is limited to FastEncoderEffort.
 	void ConfigureEncoder(bool useOMP = true, bool favorSpeedOverSize = false) { m_useOMPinEncoder = useOMP; m_favorSpeedOverSize = favorSpeedOverSize; }
 
+	/////////////////////////////////////////////////////////////////////
+	/// Sets the encoder effort level. Higher levels try more block codecs and use stronger codec settings:
+	/// smaller files, but slower encoding. The decoding speed is hardly influenced.
+	/// If speed is favored over size (see ConfigureEncoder), the effort level is limited to FastEncoderEffort.
+	/// @param effort Encoder effort level [0, MaxEncoderEffort]. Default value: DefaultEncoderEffort
+	void SetEncoderEffort(UINT8 effort) { ASSERT(effort <= MaxEncoderEffort); m_encoderEffort = effort; }
+
 	/////////////////////////////////////////////////////////////////////
 	/// Configures the decoder.
 	/// @param useOMP Use parallel threading with Open MP during decoding. Default value: true. Influences the decoding only if the codec has been compiled with OpenMP support.
@@ -259,6 +325,16 @@ public:
 	/// @param prefixSize Is only used in combination with UP_CachePrefix. It defines the number of bytes cached.
 	void ConfigureDecoder(bool useOMP = true, UserdataPolicy policy = UP_CacheAll, UINT32 prefixSize = 0) { ASSERT(prefixSize <= MaxUserDataSize);  m_useOMPinDecoder = useOMP; m_userDataPolicy = (UP_CachePrefix) ? prefixSize : 0xFFFFFFFF - policy; }
 
+	/////////////////////////////////////////////////////////////////////
+	/// Enables or disables a block codec for all encoders of this process, e.g. to omit expensive
+	/// codecs such as SC_TUNSTALL or SC_LZ4 in a deployment. Disabled codecs are not tried by the encoder.
+	/// Decoding isn't influenced: block records of disabled codecs are still decoded.
+	/// Must not be called while images are encoded.
+	/// @param codec A block codec
+	/// @param enable True: the encoder tries this codec (default); false: the codec is not used
+	/// @return False if the codec is unknown
+	static bool EnableBlockCodec(SignCompression codec, bool enable);
+
 	////////////////////////////////////////////////////////////////////
 	/// Reset stream position to start of PGF pre-header or start of data. Must not be called before Open() or before Write().
 	/// Use this method after Read() if you want to read the same image several times, e.g. reading different ROIs.
@@ -359,6 +435,14 @@ public:
 	/// @return The length of all encoded headers in bytes
 	UINT32 GetEncodedHeaderLength() const;
 
+	//////////////////////////////////////////////////////////////////////
+	/// Return a rough estimation of the encoded image size in bytes.
+	/// The estimation is based on the header: the uncompressed image size is halved for each
+	/// quality step. Use it to reserve memory of a memory stream before writing (see CPGFMemoryStream::Reserve).
+	/// Precondition: The PGF header has been set with SetHeader(...) or read with Open(...).
+	/// @return Estimated length of the encoded PGF image in bytes
+	UINT64 GetEncodedSizeEstimate() const;
+
 	//////////////////////////////////////////////////////////////////////
 	/// Return the length of an encoded PGF level in bytes.
 	/// Precondition: The PGF image has been opened with a call of Open(...).
@@ -386,6 +470,32 @@ public:
 	/// @return The number of bytes copied to the target buffer
 	UINT32 ReadEncodedData(int level, UINT8* target, UINT32 targetLen) const;
 
+	//////////////////////////////////////////////////////////////////////
+	/// Writes a reduced resolution PGF image containing the levels >= level of this image into a stream.
+	/// The encoded levels are copied without decoding, only the header and the level lengths are rewritten.
+	/// The written image has the size of this image at the given level and Levels() - level levels. The quality in the written header is lower by level, such that the
+	/// remaining subbands keep their quantization.
+	/// Precondition: The PGF image has been opened with a call of Open(...).
+	/// It might throw an IOException, e.g. CannotTruncate if the chrominance of a downsampled image
+	/// would not be downsampled at the lower quality anymore.
+	/// @param stream A PGF stream
+	/// @param level The image level of the written image
+	/// @return The number of bytes written into stream
+	UINT32 WriteTruncated(CPGFStream* stream, int level) const;
+
+	//////////////////////////////////////////////////////////////////////
+	/// Writes this image with block codecs selected anew at a given effort level into a stream.
+	/// Only the entropy coding of the block records is redone: the magnitude and sign planes are
+	/// decompressed and compressed again, the wavelet coefficients aren't changed. Headers and user data
+	/// are copied, the level lengths are rewritten.
+	/// This image can be read afterwards as before.
+	/// Precondition: The PGF image has been opened with a call of Open(...).
+	/// It might throw an IOException.
+	/// @param stream A PGF stream
+	/// @param effort Encoder effort level [0, MaxEncoderEffort] used for the codec selection
+	/// @return The number of bytes written into stream
+	UINT32 Recompress(CPGFStream* stream, UINT8 effort = MaxEncoderEffort) const;
+
 	//////////////////////////////////////////////////////////////////////
 	/// Return current image width of given channel in pixels.
 	/// The returned width depends on the levels read so far and on ROI.
@@ -532,6 +642,7 @@ protected:
 	int m_currentLevel;				///< transform level of current image
 	UINT32 m_userDataPolicy;		///< user data (metadata) policy during open
 	BYTE m_quant;					///< quantization parameter
+	UINT8 m_encoderEffort;			///< encoder effort level
 	bool m_downsample;				///< chrominance channels are downsampled
 	bool m_favorSpeedOverSize;		///< favor encoding speed over compression ratio
 	bool m_useOMPinEncoder;			///< use Open MP in encoder
@@ -546,18 +657,27 @@ private:
 	void *m_cbArg;					///< refresh callback argument
 	double m_percent;				///< progress [0..1]
 	ProgressMode m_progressMode;	///< progress mode used in Read and Write; PM_Relative is default mode
+	DataT* m_importRows[MaxChannels];	///< row buffers of a streaming import (see BeginImport)
+	int m_importMap[MaxChannels];	///< channel map of a streaming import
+	UINT32 m_importedRows;			///< number of rows received in a streaming import
+	UINT32 m_importPending;			///< number of buffered odd rows of downsampled channels (0 or 1)
+	BYTE m_importBpp;				///< bits per pixel of the rows of a streaming import
+	bool m_importing;				///< a streaming import is in progress
 
 	void Init();
 	void ComputeLevels();
 	bool CompleteHeader();
-	void RgbToYuv(int pitch, UINT8* rgbBuff, BYTE bpp, int channelMap[], CallbackPtr cb, void *data);
+	void RgbToYuv(int pitch, UINT8* rgbBuff, BYTE bpp, int channelMap[], CallbackPtr cb, void *data, DataT* const channel[], UINT32 nRows);
 	void Downsample(int nChannel);
+	UINT32 DownsampleRows(DataT* buff, UINT32 nRows, bool lastRows) const;
+	void ImportStrip(UINT32 nRows);
 	UINT32 UpdatePostHeaderSize();
 	void WriteLevel();
 
 #ifdef __PGFROISUPPORT__
 	PGFRect GetAlignedROI(int c = 0) const;
 	void SetROI(PGFRect rect);
+	void ReadTiles();
 #endif
 
 	UINT8 Clamp4(DataT v) const {
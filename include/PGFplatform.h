@@ -239,6 +239,9 @@ typedef bool (__cdecl *CallbackPtr)(double percent, bool escapeAllowed, void *da
 #define ColorTableError		0x20000008			///< errors related to color table size
 #define PNGError			0x20000009			///< errors in png functions
 #define MissingData			0x2000000A			///< expected data cannot be read
+#define ReadOnlyStream		0x2000000B			///< stream cannot be written
+#define CannotTruncate		0x2000000C			///< levels cannot be removed without changing the quantization
+#define BlockTooLarge		0x2000000D			///< block record length doesn't fit into its 16 bit length field
 
 //-------------------------------------------------------------------------------
 // methods
@@ -504,6 +507,9 @@ __inline int MulDiv(int nNumber, int nNumerator, int nDenominator) {
 #define ColorTableError			0x2008			///< errors related to color table size
 #define PNGError				0x2009			///< errors in png functions
 #define MissingData				0x200A			///< expected data cannot be read
+#define ReadOnlyStream			0x200B			///< stream cannot be written
+#define CannotTruncate			0x200C			///< levels cannot be removed without changing the quantization
+#define BlockTooLarge			0x200D			///< block record length doesn't fit into its 16 bit length field
 
 //-------------------------------------------------------------------------------
 // methods
@@ -32,6 +32,8 @@
 #include "PGFtypes.h"
 #include <new>
 
+#define FileStreamBufferSize	(1 << 16)	///< recommended stream buffer size of buffered file streams
+
 /////////////////////////////////////////////////////////////////////
 /// Abstract stream base class.
 /// @author C. Stamm
@@ -73,30 +75,55 @@ public:
 	/// Check stream validity.
 	/// @return True if stream and current position is valid
 	virtual bool IsValid() const=0;
+
+	//////////////////////////////////////////////////////////////////////
+	/// Zero-copy access to the stream data at the current stream position.
+	/// Streams without direct access to their data return nullptr.
+	/// The returned data stay valid until the stream is written or destroyed.
+	/// @param available [out] Number of bytes between the current stream position and the end of stream
+	/// @return Address of the stream data at the current stream position or nullptr
+	virtual const UINT8* GetData(UINT64& available) const { available = 0; return nullptr; }
 };
 
 /////////////////////////////////////////////////////////////////////
 /// A PGF stream subclass for external storage files.
+/// Optionally, small reads and writes are collected in a stream buffer. A buffered
+/// file stream owns the file position: the buffer is flushed on seeks, on Flush(),
+/// and on destruction. Call Flush() before the file handle is used or closed by others.
 /// @author C. Stamm
 /// @brief File stream class
 class CPGFFileStream : public CPGFStream {
 protected:
-	HANDLE m_hFile;	///< file handle
+	HANDLE m_hFile;			///< file handle
+	UINT8 *m_buffer;		///< stream buffer or nullptr if unbuffered
+	UINT32 m_bufferSize;	///< size of stream buffer
+	UINT32 m_bufferLen;		///< number of valid bytes in stream buffer
+	UINT32 m_bufferPos;		///< current position in stream buffer
+	UINT64 m_bufferStart;	///< file position of stream buffer
+	bool   m_dirty;			///< stream buffer contains written bytes: file position is m_bufferStart
 
 public:
-	CPGFFileStream() : m_hFile(0) {}
+	CPGFFileStream() : m_hFile(0), m_buffer(nullptr), m_bufferSize(0), m_bufferLen(0), m_bufferPos(0), m_bufferStart(0), m_dirty(false) {}
 	/// Constructor
 	/// @param hFile File handle
-	CPGFFileStream(HANDLE hFile) : m_hFile(hFile) {}
+	/// @param bufferSize Size of stream buffer in bytes (0: unbuffered, see also FileStreamBufferSize)
+	CPGFFileStream(HANDLE hFile, UINT32 bufferSize = 0); // throws IOException
 	/// @return File handle
 	HANDLE GetHandle() { return m_hFile; }
 
-	virtual ~CPGFFileStream() { m_hFile = 0; }
+	virtual ~CPGFFileStream();
 	virtual void Write(int *count, void *buffer); // throws IOException
 	virtual void Read(int *count, void *buffer); // throws IOException
 	virtual void SetPos(short posMode, INT64 posOff); // throws IOException
 	virtual UINT64 GetPos() const; // throws IOException
 	virtual bool   IsValid() const	{ return m_hFile != 0; }
+
+	/// Write buffered bytes into file and set the file position to the stream position.
+	/// It might throw an IOException.
+	void Flush();
+
+private:
+	void WriteBuffer(); // throws IOException
 };
 
 /////////////////////////////////////////////////////////////////////
@@ -110,6 +137,9 @@ protected:
 	size_t m_size;			///< buffer size
 	bool   m_allocated;		///< indicates a new allocated buffer
 
+	/// Constructor for subclasses: the memory is provided with Reinitialize
+	CPGFMemoryStream() : m_buffer(0), m_pos(0), m_eos(0), m_size(0), m_allocated(false) {}
+
 public:
 	/// Constructor
 	/// @param size Size of new allocated memory buffer
@@ -125,11 +155,17 @@ public:
 	/// @param size Memory size
 	void Reinitialize(UINT8 *pBuffer, size_t size);
 
+	/// Enlarges an allocated memory buffer to at least the given capacity.
+	/// Use it with an estimated stream length (see CPGFImage::GetEncodedSizeEstimate) to avoid reallocations while writing.
+	/// It might throw an IOException.
+	/// @param capacity Minimum memory size in bytes
+	void Reserve(size_t capacity);
+
 	virtual ~CPGFMemoryStream() {
 		m_pos = 0;
 		if (m_allocated) {
 			// the memory buffer has been allocated inside of CPMFmemoryStream constructor
-			delete[] m_buffer; m_buffer = 0;
+			free(m_buffer); m_buffer = 0;
 		}
 	}
 
@@ -138,6 +174,7 @@ public:
 	virtual void SetPos(short posMode, INT64 posOff); // throws IOException
 	virtual UINT64 GetPos() const { ASSERT(IsValid()); return m_pos - m_buffer; }
 	virtual bool   IsValid() const	{ return m_buffer != 0; }
+	virtual const UINT8* GetData(UINT64& available) const { ASSERT(IsValid()); available = m_eos - m_pos; return m_pos; }
 
 	/// @return Memory size
 	size_t GetSize() const			{ return m_size; }
@@ -149,6 +186,31 @@ public:
 	UINT64 GetEOS() const			{ ASSERT(IsValid()); return m_eos - m_buffer; }
 	/// @param length Stream length (= relative position of end of stream)
 	void SetEOS(UINT64 length)		{ ASSERT(IsValid()); m_eos = m_buffer + length; }
+
+private:
+	void Resize(size_t size); // throws IOException
+};
+
+/////////////////////////////////////////////////////////////////////
+/// A read-only PGF stream subclass for memory-mapped files.
+/// The decoder reads block records directly out of the mapping (see GetData),
+/// and the mapped pages are shared by all processes reading the same file.
+/// @brief Memory-mapped file stream class
+class CPGFMMapStream : public CPGFMemoryStream {
+protected:
+#if defined(WIN32) || defined(WINCE)
+	HANDLE m_hMapping;		///< file mapping object
+#endif
+
+public:
+	/// Constructor: maps the whole file read-only.
+	/// The stream position is set to the current file position.
+	/// It might throw an IOException.
+	/// @param hFile File handle of a file opened for reading
+	CPGFMMapStream(HANDLE hFile);
+
+	virtual ~CPGFMMapStream();
+	virtual void Write(int *count, void *buffer); // throws IOException
 };
 
 /////////////////////////////////////////////////////////////////////
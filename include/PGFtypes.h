@@ -92,6 +92,9 @@
 #endif
 #define MaxBitPlanesLog		5					///< number of bits to code the maximum number of bit planes (in 32 or 16 bit mode)
 #define MaxQuality			MaxBitPlanes		///< maximum quality
+#define MaxEncoderEffort	9					///< maximum encoder effort level: all block codecs are tried
+#define DefaultEncoderEffort 5					///< default encoder effort level
+#define FastEncoderEffort	1					///< encoder effort level used if speed is favored over size
 
 //-------------------------------------------------------------------------------
 // Types
@@ -113,7 +116,8 @@ enum SignCompression {
 	SC_SB2,
 };
 
-enum { SCFLAG_PATCHES = 0x80 };
+/// sign type flags: patches or a plane of magnitude high bytes follow the signs
+enum { SCFLAG_PATCHES = 0x80, SCFLAG_WIDE = 0x40 };
 
 /// general PGF file structure
 /// PGFPreHeader PGFHeader [PGFPostHeader] LevelLengths Level_n-1 Level_n-2 ... Level_0
@@ -0,0 +1,152 @@
+/*
+ * The Progressive Graphics File; http://www.libpgf.org
+ *
+ * This file Copyright (C) 2026 The libpgf contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LESSER GENERAL PUBLIC LICENSE
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+//////////////////////////////////////////////////////////////////////
+/// @file BlockCodec.cpp
+/// @brief Registry of the block codecs of byte planes
+/// @author The libpgf contributors
+
+#include <limits.h>
+#include <string.h>
+
+#include "BlockCodec.h"
+
+#include "bitpack/bitpack.h"
+#include "fpc/fpc.h"
+#include "fse/fse.h"
+#include "lz4/lz4.h"
+#include "lz4/lz4hc.h"
+#include "srle/sparserle.h"
+#include "tunstall/tunstall.h"
+#include "zeropack/zeropack.h"
+
+//////////////////////////////////////////////////////////////////////
+// Codec adapters: all codecs are reentrant.
+// The codecs without documented bounds are known to stay below three times the input length.
+
+static UINT32 WorstCaseBound(UINT32 len) { return 3*len; }
+
+// SC_NONE: the plane is stored uncompressed
+static void NoneDecompress(const UINT8* in, UINT32, UINT8* out, UINT32 len) { memcpy(out, in, len); }
+
+// SC_FSE: 0 means incompressible, 1 a single symbol
+static UINT32 FseCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32 outLen, const BlockCodecParams& params) {
+	const size_t size = FSE_compress2(out, outLen, in, len, 0, params.fseTableLog);
+	return (FSE_isError(size) || size < 2) ? NoCodecSize : (UINT32)size;
+}
+static void FseDecompress(const UINT8* in, UINT32 inLen, UINT8* out, UINT32 len) { FSE_decompress(out, len, in, inLen); }
+static UINT32 FseBound(UINT32 len) { return (UINT32)FSE_compressBound(len); }
+
+// SC_FPC
+static UINT32 FpcCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return (UINT32)FPC_compress(out, in, len, 0); }
+static void FpcDecompress(const UINT8* in, UINT32 inLen, UINT8* out, UINT32 len) { FPC_decompress(out, len, in, inLen); }
+static UINT32 FpcBound(UINT32 len) { return FPC_MAX_OUTPUT(len, 0); }
+
+// SC_LZ4: HC mode, 0 means failure
+static UINT32 Lz4Compress(const UINT8* in, UINT32 len, UINT8* out, UINT32 outLen, const BlockCodecParams& params) {
+	const int size = LZ4_compress_HC((const char *) in, (char *) out, len, outLen, params.lz4Level);
+	return (size > 0) ? (UINT32)size : NoCodecSize;
+}
+static void Lz4Decompress(const UINT8* in, UINT32 inLen, UINT8* out, UINT32 len) { LZ4_decompress_safe((const char *) in, (char *) out, inLen, len); }
+static UINT32 Lz4Bound(UINT32 len) { return LZ4_COMPRESSBOUND(len); }
+
+// SC_SRLE
+static UINT32 SrleCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return sparserle_comp(in, out, len); }
+static void SrleDecompress(const UINT8* in, UINT32 inLen, UINT8* out, UINT32) { sparserle_decomp(in, out, inLen); }
+
+// SC_SRLE_BIT
+static UINT32 SrleBitCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return sparsebitrle_comp(in, out, len); }
+static void SrleBitDecompress(const UINT8* in, UINT32, UINT8* out, UINT32 len) { sparsebitrle_decomp(in, out, len); }
+
+// SC_ZP
+static UINT32 ZpCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return zeropack_comp_rec(in, out, len); }
+static void ZpDecompress(const UINT8* in, UINT32, UINT8* out, UINT32 len) { zeropack_decomp_rec(in, out, len); }
+
+// SC_TUNSTALL
+static UINT32 TunstallCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return tunstall_comp(in, out, len); }
+static void TunstallDecompress(const UINT8* in, UINT32, UINT8* out, UINT32 len) { tunstall_decomp(in, out, len); }
+
+// SC_BP
+static UINT32 BpCompress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return bitpack_comp(in, out, len); }
+static void BpDecompress(const UINT8* in, UINT32, UINT8* out, UINT32 len) { bitpack_decomp(in, out, len); }
+
+// SC_SB2
+static UINT32 Sb2Compress(const UINT8* in, UINT32 len, UINT8* out, UINT32, const BlockCodecParams&) { return sb2_comp(in, out, len); }
+static void Sb2Decompress(const UINT8* in, UINT32, UINT8* out, UINT32 len) { sb2_decomp(in, out, len); }
+
+#define RLEPreference			16		///< size bonus of the run-length codecs (faster decoding)
+#define BothPlanes				(CodecPlaneAbs | CodecPlaneSign)
+
+//////////////////////////////////////////////////////////////////////
+// Codec table in the order the encoder tries the codecs: the run-length codecs come last,
+// because a result is kept if it is smaller than the best result so far plus its preference.
+// New codecs get a new id (see SignCompression and NofBlockCodecs) and an entry in this table.
+static BlockCodec BlockCodecs[] = {
+	{ SC_FSE,		FseCompress,		FseDecompress,		FseBound,		BothPlanes,		0,				true },
+	{ SC_FPC,		FpcCompress,		FpcDecompress,		FpcBound,		BothPlanes,		0,				true },
+	{ SC_LZ4,		Lz4Compress,		Lz4Decompress,		Lz4Bound,		CodecPlaneSign,	0,				true },
+	{ SC_ZP,		ZpCompress,			ZpDecompress,		WorstCaseBound,	CodecPlaneAbs,	0,				true },
+	{ SC_TUNSTALL,	TunstallCompress,	TunstallDecompress,	WorstCaseBound,	CodecPlaneAbs,	0,				true },
+	{ SC_BP,		BpCompress,			BpDecompress,		WorstCaseBound,	CodecPlaneAbs,	0,				true },
+	{ SC_SRLE_BIT,	SrleBitCompress,	SrleBitDecompress,	WorstCaseBound,	BothPlanes,		RLEPreference,	true },
+	{ SC_SB2,		Sb2Compress,		Sb2Decompress,		WorstCaseBound,	CodecPlaneAbs,	RLEPreference,	true },
+	{ SC_SRLE,		SrleCompress,		SrleDecompress,		WorstCaseBound,	BothPlanes,		RLEPreference,	true },
+	{ SC_NONE,		nullptr,			NoneDecompress,		nullptr,		BothPlanes,		0,				true },
+};
+static const int NofTableEntries = sizeof(BlockCodecs)/sizeof(BlockCodecs[0]);
+
+//////////////////////////////////////////////////////////////////////
+// Returns the codec table in the order the encoder tries the codecs.
+const BlockCodec* GetBlockCodecs(int& n) {
+	n = NofTableEntries;
+	return BlockCodecs;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Returns the codec of a given id, if it applies to the given plane, otherwise nullptr.
+const BlockCodec* FindBlockCodec(UINT8 id, UINT32 plane) {
+	for (int i=0; i < NofTableEntries; i++) {
+		if (BlockCodecs[i].id == id) return (BlockCodecs[i].planes & plane) ? &BlockCodecs[i] : nullptr;
+	}
+	return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Returns the set of enabled codecs of a given plane (bit mask of CodecBit).
+UINT32 EnabledBlockCodecs(UINT32 plane) {
+	UINT32 codecs = 0;
+
+	for (int i=0; i < NofTableEntries; i++) {
+		if (BlockCodecs[i].enabled && BlockCodecs[i].compress && (BlockCodecs[i].planes & plane)) codecs |= CodecBit(BlockCodecs[i].id);
+	}
+	return codecs;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Enables or disables a codec for all encoders. Returns false if there is no codec with this id.
+bool EnableBlockCodec(SignCompression id, bool enable) {
+	for (int i=0; i < NofTableEntries; i++) {
+		if (BlockCodecs[i].id == id) {
+			BlockCodecs[i].enabled = enable;
+			return true;
+		}
+	}
+	return false;
+}
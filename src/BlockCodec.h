@@ -0,0 +1,93 @@
+/*
+ * The Progressive Graphics File; http://www.libpgf.org
+ *
+ * This file Copyright (C) 2026 The libpgf contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LESSER GENERAL PUBLIC LICENSE
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+//////////////////////////////////////////////////////////////////////
+/// @file BlockCodec.h
+/// @brief Registry of the block codecs of byte planes
+/// @author The libpgf contributors
+
+#ifndef PGF_BLOCKCODEC_H
+#define PGF_BLOCKCODEC_H
+
+#include "PGFtypes.h"
+
+//////////////////////////////////////////////////////////////////////
+// Constants
+#define NofBlockCodecs		(SC_SB2 + 1)		///< largest codec id + 1; codec ids of sign planes have to be smaller than SCFLAG_WIDE
+#define CodecPlaneAbs		1					///< codec of magnitude planes and planes of magnitude high bytes
+#define CodecPlaneSign		2					///< codec of packed sign planes
+#define CodecBit(sc)		(1U << (sc))		///< bit of a codec in a set of codecs
+#define NoCodecSize			USHRT_MAX			///< result of a failed compression
+
+//////////////////////////////////////////////////////////////////////
+/// Codec settings depending on the encoder effort level.
+/// @brief Block codec settings
+struct BlockCodecParams {
+	int lz4Level;			///< LZ4 HC compression level
+	unsigned fseTableLog;	///< maximum FSE table log
+};
+
+//////////////////////////////////////////////////////////////////////
+/// A block codec compresses a byte plane of a macro block. The codec id is stored
+/// in the block record in front of the compressed plane (see CEncoder::CMacroBlock::Compress).
+/// The encoder tries the enabled codecs in the order of the codec table, the decoder
+/// dispatches by codec id, independent of the enabled flag.
+/// @brief Block codec of a byte plane
+struct BlockCodec {
+	SignCompression id;		///< codec id stored in block records
+	/// Compresses len bytes into out with a capacity of outLen >= bound(len) bytes.
+	/// Returns the compressed length or NoCodecSize if the codec cannot handle the plane.
+	/// nullptr: the codec is never tried by the encoder (SC_NONE).
+	UINT32 (*compress)(const UINT8* in, UINT32 len, UINT8* out, UINT32 outLen, const BlockCodecParams& params);
+	/// Decompresses inLen bytes into len bytes of out.
+	void (*decompress)(const UINT8* in, UINT32 inLen, UINT8* out, UINT32 len);
+	UINT32 (*bound)(UINT32 len);	///< worst case compressed length of len bytes
+	UINT32 planes;			///< planes the codec applies to: CodecPlaneAbs, CodecPlaneSign, or both
+	UINT32 preference;		///< size bonus in bytes of codecs with fast decoding
+	bool enabled;			///< codec is tried by the encoder
+};
+
+//////////////////////////////////////////////////////////////////////
+/// Returns the codec table in the order the encoder tries the codecs.
+/// @param n [out] Number of codecs in the table
+/// @return The codec table
+const BlockCodec* GetBlockCodecs(int& n);
+
+//////////////////////////////////////////////////////////////////////
+/// Returns the codec of a given id, if it applies to the given plane.
+/// @param id Codec id read from a block record
+/// @param plane CodecPlaneAbs or CodecPlaneSign
+/// @return The codec or nullptr if there is no such codec for this plane
+const BlockCodec* FindBlockCodec(UINT8 id, UINT32 plane);
+
+//////////////////////////////////////////////////////////////////////
+/// Returns the set of enabled codecs of a given plane.
+/// @param plane CodecPlaneAbs or CodecPlaneSign
+/// @return Set of codecs (bit mask of CodecBit)
+UINT32 EnabledBlockCodecs(UINT32 plane);
+
+//////////////////////////////////////////////////////////////////////
+/// Enables or disables a codec for all encoders (see CPGFImage::EnableBlockCodec).
+/// @param id Codec id
+/// @param enable True: the encoder tries this codec
+/// @return False if there is no codec with this id
+bool EnableBlockCodec(SignCompression id, bool enable);
+
+#endif //PGF_BLOCKCODEC_H
@@ -27,18 +27,12 @@
 /// @author C. Stamm, R. Spuler
 
 #include "Decoder.h"
+#include "BlockCodec.h"
+#include "SIMD.h"
 #ifdef TRACE
 	#include <stdio.h>
 #endif
 
-#include "bitpack/bitpack.h"
-#include "fpc/fpc.h"
-#include "fse/fse.h"
-#include "lz4/lz4.h"
-#include "srle/sparserle.h"
-#include "tunstall/tunstall.h"
-#include "zeropack/zeropack.h"
-
 //////////////////////////////////////////////////////
 // PGF: file structure
 //
@@ -94,6 +88,7 @@ CDecoder::CDecoder(CPGFStream* stream, PGFPreHeader& preHeader, PGFHeader& heade
 , m_macroBlocksAvailable(0)
 #ifdef __PGFROISUPPORT__
 , m_roi(false)
+, m_tileDecoder(false)
 #endif
 {
 	ASSERT(m_stream);
@@ -138,7 +133,10 @@ CDecoder::CDecoder(CPGFStream* stream, PGFPreHeader& preHeader, PGFHeader& heade
 
 	// be ready to read all versions including version 0
 	if (preHeader.version > 0) {
-#ifndef __PGFROISUPPORT__
+#ifdef __PGFROISUPPORT__
+		// ROI encoding scheme: block records are preceded by their length and a ROI block header
+		m_roi = (preHeader.version & PGFROI) && header.nLevels > 0;
+#else
 		// check ROI usage
 		if (preHeader.version & PGFROI) ReturnWithError(FormatCannotRead);
 #endif
@@ -239,6 +237,34 @@ CDecoder::CDecoder(CPGFStream* stream, PGFPreHeader& preHeader, PGFHeader& heade
 	}
 }
 
+#ifdef __PGFROISUPPORT__
+/////////////////////////////////////////////////////////////////////
+// Constructor of a tile decoder: decodes the block records of a single tile (see ReadTile).
+// The tile decoder owns the given stream.
+// It might throw an IOException.
+CDecoder::CDecoder(CPGFStream* tileStream)
+: m_stream(tileStream)
+, m_startPos(0)
+, m_streamSizeEstimation(0)
+, m_encodedHeaderLength(0)
+, m_macroBlocks(nullptr)
+, m_currentBlockIndex(0)
+, m_macroBlockLen(1)
+, m_macroBlocksAvailable(0)
+, m_currentBlock(nullptr)
+, m_roi(true)
+, m_tileDecoder(true)
+{
+	ASSERT(m_stream);
+
+	m_currentBlock = new(std::nothrow) CMacroBlock();
+	if (!m_currentBlock) {
+		delete m_stream; m_stream = nullptr;
+		ReturnWithError(InsufficientMemory);
+	}
+}
+#endif
+
 /////////////////////////////////////////////////////////////////////
 // Destructor
 CDecoder::~CDecoder() {
@@ -248,6 +274,9 @@ CDecoder::~CDecoder() {
 	} else {
 		delete m_currentBlock;
 	}
+#ifdef __PGFROISUPPORT__
+	if (m_tileDecoder) delete m_stream;
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -490,7 +519,7 @@ void CDecoder::DequantizeValue8(CSubband* band, UINT32 bandPos, const UINT8 quan
 	}
 
 	UINT64 v;
-	const UINT64 ands[8] = {
+	const UINT64 ands[16] = {
 		0xffffffffffffffff,
 		0x7fff7fff7fff7fff,
 		0x3fff3fff3fff3fff,
@@ -499,7 +528,16 @@ void CDecoder::DequantizeValue8(CSubband* band, UINT32 bandPos, const UINT8 quan
 		0x07ff07ff07ff07ff,
 		0x03ff03ff03ff03ff,
 		0x01ff01ff01ff01ff,
+		0x00ff00ff00ff00ff,
+		0x007f007f007f007f,
+		0x003f003f003f003f,
+		0x001f001f001f001f,
+		0x000f000f000f000f,
+		0x0007000700070007,
+		0x0003000300030003,
+		0x0001000100010001,
 	};
+	ASSERT(quantParam < 16);
 
 	ptrunion u;
 	u.d = &m_currentBlock->m_value[m_currentBlock->m_valuePos];
@@ -536,8 +574,8 @@ void CDecoder::GetNextMacroBlock() {
 
 //////////////////////////////////////////////////////////////////////
 // Reads next block(s) from stream and decodes them
-// Decoding scheme: <wordLen>(16 bits) [ ROI ] data
-//		ROI	  ::= <bufferSize>(15 bits) <eofTile>(1 bit)
+// Decoding scheme: [ <blockLen>(16 bits) ROI ] Block (see ReadMacroBlock)
+//		ROI	  ::= <bufferSize>(15 bits) <tileEnd>(1 bit)
 // It might throw an IOException.
 void CDecoder::DecodeBuffer() {
 	ASSERT(m_macroBlocksAvailable <= 0);
@@ -546,7 +584,7 @@ void CDecoder::DecodeBuffer() {
 	if (m_macroBlockLen == 1) {
 		ASSERT(m_currentBlock);
 		ReadMacroBlock(m_currentBlock);
-		//m_currentBlock->BitplaneDecode();
+		m_currentBlock->Decompress();
 		m_macroBlocksAvailable = 1;
 	} else {
 		m_macroBlocksAvailable = 0;
@@ -564,11 +602,11 @@ void CDecoder::DecodeBuffer() {
 			}
 		}
 #ifdef LIBPGF_USE_OPENMP
-		// decode in parallel
+		// decompress in parallel
 		#pragma omp parallel for default(shared) //no declared exceptions in next block
 #endif
 		for (int i=0; i < m_macroBlocksAvailable; i++) {
-			m_macroBlocks[i]->BitplaneDecode();
+			m_macroBlocks[i]->Decompress();
 		}
 
 		// prepare current macro block
@@ -578,97 +616,275 @@ void CDecoder::DecodeBuffer() {
 }
 
 //////////////////////////////////////////////////////////////////////
-// Reads next block from stream and stores it in the given macro block
+// Reads and decompresses exactly one block record at the current stream position.
+// Used to recode the block records of an image (see CPGFImage::Recompress).
+// It might throw an IOException.
+const DataT* CDecoder::DecodeBlock(ROIBlockHeader& header) {
+	ASSERT(m_currentBlock);
+
+	m_macroBlocksAvailable = 0;
+	ReadMacroBlock(m_currentBlock);
+	m_currentBlock->Decompress();
+	header = m_currentBlock->m_header;
+	return m_currentBlock->m_value;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Read a 16 bit value in stream byte order from a code buffer.
+static inline UINT16 GetUINT16(const UINT8* p) {
+	UINT16 val;
+	memcpy(&val, p, sizeof(UINT16));
+	return __VAL(val);
+}
+
+/////////////////////////////////////////////////////////////////////
+// Check type and length of a coded byte plane: an uncompressed plane has the full length.
+static inline bool IsValidPlane(UINT8 type, UINT32 wordLen) {
+	return FindBlockCodec(type, CodecPlaneAbs) && wordLen <= BufferSize && (type != SC_NONE || wordLen == 0 || wordLen == BufferSize);
+}
+
+/////////////////////////////////////////////////////////////////////
+// Check the block record at the given address with at most avail accessible bytes.
+// Returns the length of a valid block record, 0 if the block record is invalid,
+// or a value larger than avail if the block record is truncated.
+static UINT32 BlockRecordLength(const UINT8* const code, UINT32 avail) {
+	const UINT8 * const end = code + avail;
+	const UINT8 *p = code;
+	UINT32 wordLen;
+
+	// type and wordLen
+	if (avail < 1 + sizeof(UINT16)) return avail + 1;
+	wordLen = GetUINT16(p + 1);
+	if (!IsValidPlane(p[0], wordLen)) return 0;
+	p += 1 + sizeof(UINT16);
+	if (!wordLen) return UINT32(p - code);
+
+	// magnitudes and sign type
+	if ((UINT32)(end - p) < wordLen + 1) return avail + 1;
+	p += wordLen;
+	const bool patches = *p & SCFLAG_PATCHES;
+	const bool wide = *p & SCFLAG_WIDE;
+	const UINT8 type = *p++ & ~(SCFLAG_PATCHES | SCFLAG_WIDE);
+	if (!FindBlockCodec(type, CodecPlaneSign) || (patches && wide)) return 0;
+
+	// signs
+	if (type == SC_NONE) {
+		wordLen = 2048;
+	} else {
+		if ((UINT32)(end - p) < sizeof(UINT16)) return avail + 1;
+		wordLen = GetUINT16(p);
+		if (wordLen > BufferSize) return 0;
+		p += sizeof(UINT16);
+	}
+	if ((UINT32)(end - p) < wordLen) return avail + 1;
+	p += wordLen;
+
+	if (patches) {
+		if (p == end) return avail + 1;
+		const UINT32 patchLen = *p++*2*sizeof(UINT16);
+		if ((UINT32)(end - p) < patchLen) return avail + 1;
+		for (UINT32 i = 0; i < patchLen; i += 2*sizeof(UINT16)) {
+			if (GetUINT16(p + i) >= BufferSize) return 0;
+		}
+		p += patchLen;
+	} else if (wide) {
+		if ((UINT32)(end - p) < 1 + sizeof(UINT16)) return avail + 1;
+		wordLen = GetUINT16(p + 1);
+		if (!wordLen || !IsValidPlane(p[0], wordLen)) return 0;
+		p += 1 + sizeof(UINT16);
+		if ((UINT32)(end - p) < wordLen) return avail + 1;
+		p += wordLen;
+	}
+	return UINT32(p - code);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Reads next block record from stream and stores it in the code buffer of the given macro block.
+// If the stream provides direct access to its data (see CPGFStream::GetData), the block record
+// is not copied: the macro block refers to the stream data instead.
+// The block record is checked, but not decompressed: call CMacroBlock::Decompress afterwards.
+// Block record: <absType>(8 bits) <absLen>(16 bits) absData [ Sign [ Patches | Wide ] ]
+//		Sign	::= <signType>(8 bits) ( signs(2048 bytes) | <signLen>(16 bits) signData )
+//		Patches	::= <numPatches>(8 bits) foreach(patch): <address>(16 bits) <value>(16 bits)
+//		Wide	::= <highType>(8 bits) <highLen>(16 bits) highData
+// In the ROI encoding scheme the block record is preceded by its length and the ROI block header:
+//		<blockLen>(16 bits) ROI Block
+//		ROI		::= <bufferSize>(15 bits) <tileEnd>(1 bit)
 // It might throw an IOException.
 void CDecoder::ReadMacroBlock(CMacroBlock* block) {
 	ASSERT(block);
 
+	UINT8 * const code = (UINT8 *) block->m_codeBuffer;
+	UINT8 *p = code;
 	UINT16 wordLen;
 	ROIBlockHeader h(BufferSize);
-	int count, expected;
-	UINT8 absbuf[BufferSize] __attribute__((aligned(8))), tmpbuf[BufferSize], packedsign[2048];
-	UINT32 i;
+	int count, expected = 0;
 
 #ifdef TRACE
 	//UINT32 filePos = (UINT32)m_stream->GetPos();
 	//printf("DecodeBuffer: %d\n", filePos);
 #endif
 
-	UINT8 type;
-	count = expected = 1;
-	m_stream->Read(&count, &type);
+	// the length of the block record is only known in the ROI encoding scheme
+	bool knownLength = false;
 
-	// read wordLen
-	count = expected = sizeof(UINT16);
-	m_stream->Read(&count, &wordLen);
-	if (count != expected) ReturnWithError(MissingData);
-	wordLen = __VAL(wordLen); // convert wordLen
-	if (wordLen > BufferSize) ReturnWithError(FormatCannotRead);
+#ifdef __PGFROISUPPORT__
+	if (m_roi) {
+		// block length and ROI block header
+		UINT16 prefix[2];
+		count = sizeof(prefix);
+		m_stream->Read(&count, prefix);
+		if (count != sizeof(prefix)) ReturnWithError(MissingData);
+		const int blockLen = __VAL(prefix[0]);
+		h.val = __VAL(prefix[1]);
+		if (h.rbh.bufferSize > BufferSize) ReturnWithError(FormatCannotRead);
+		expected = blockLen;
+		knownLength = true;
+	}
+#endif
+	if (knownLength && expected > CodeBufferLen*WordBytes) ReturnWithError(FormatCannotRead);
 
 	// save header
 	block->m_header = h;
+	block->m_valuePos = 0;
 
-	// read data
-	if (!wordLen) {
-		memset(block->m_value, 0, sizeof(DataT) * BufferSize);
-	} else {
-		count = expected = wordLen;
-		m_stream->Read(&count, tmpbuf);
+	// zero-copy: decompress the block record directly from the stream data
+	UINT64 available;
+	const UINT8 *data = m_stream->GetData(available);
+	if (data) {
+		const UINT32 avail = (UINT32)__min(available, UINT64(CodeBufferLen*WordBytes));
+
+		if (knownLength) {
+			if ((UINT32)expected > avail) ReturnWithError(MissingData);
+			count = BlockRecordLength(data, expected);
+			if (count != expected) ReturnWithError(FormatCannotRead);
+		} else {
+			count = BlockRecordLength(data, avail);
+			if (!count) ReturnWithError(FormatCannotRead);
+			if ((UINT32)count > avail) ReturnWithError(MissingData);
+		}
+		m_stream->SetPos(FSFromCurrent, count);
+		block->m_code = data;
+		return;
+	}
+	block->m_code = code;
+
+	if (knownLength) {
+		// block length is known: read the whole block record at once
+		count = expected;
+		m_stream->Read(&count, code);
 		if (count != expected) ReturnWithError(MissingData);
+		if (BlockRecordLength(code, count) != (UINT32)count) ReturnWithError(FormatCannotRead);
+		return;
+	}
+
+	// read type and wordLen
+	count = expected = 1 + sizeof(UINT16);
+	m_stream->Read(&count, p);
+	if (count != expected) ReturnWithError(MissingData);
+	wordLen = GetUINT16(p + 1);
+	if (!IsValidPlane(p[0], wordLen)) ReturnWithError(FormatCannotRead);
+	p += count;
 
-		if (type == SC_FSE)
-			FSE_decompress(absbuf, BufferSize, tmpbuf, wordLen);
-		else if (type == SC_ZP)
-			zeropack_decomp_rec(tmpbuf, absbuf, 16384);
-		else if (type == SC_TUNSTALL)
-			tunstall_decomp(tmpbuf, absbuf, 16384);
-		else if (type == SC_SRLE)
-			sparserle_decomp(tmpbuf, absbuf, wordLen);
-		else if (type == SC_SRLE_BIT)
-			sparsebitrle_decomp(tmpbuf, absbuf, 16384);
-		else if (type == SC_BP)
-			bitpack_decomp(tmpbuf, absbuf, 16384);
-		else if (type == SC_SB2)
-			sb2_decomp(tmpbuf, absbuf, 16384);
-		else
-			FPC_decompress(absbuf, BufferSize, tmpbuf, wordLen);
+	if (wordLen) {
+		// read magnitudes
+		count = expected = wordLen;
+		m_stream->Read(&count, p);
+		if (count != expected) ReturnWithError(MissingData);
+		p += count;
 
+		// read signs
 		count = expected = 1;
-		m_stream->Read(&count, &type);
+		m_stream->Read(&count, p);
 		if (count != expected) ReturnWithError(MissingData);
-
-		const bool patches = type & SCFLAG_PATCHES;
-		type &= ~SCFLAG_PATCHES;
+		const bool patches = *p & SCFLAG_PATCHES;
+		const bool wide = *p & SCFLAG_WIDE;
+		const UINT8 type = *p++ & ~(SCFLAG_PATCHES | SCFLAG_WIDE);
+		if (!FindBlockCodec(type, CodecPlaneSign) || (patches && wide)) ReturnWithError(FormatCannotRead);
 
 		if (type == SC_NONE) {
-			count = expected = 2048;
-			m_stream->Read(&count, packedsign);
+			wordLen = 2048;
 		} else {
 			count = expected = sizeof(UINT16);
-			m_stream->Read(&count, &wordLen);
-			wordLen = __VAL(wordLen);
-			if (count != expected) ReturnWithError(MissingData);
-			count = expected = wordLen;
-			m_stream->Read(&count, tmpbuf);
+			m_stream->Read(&count, p);
 			if (count != expected) ReturnWithError(MissingData);
+			wordLen = GetUINT16(p);
+			if (wordLen > BufferSize) ReturnWithError(FormatCannotRead);
+			p += count;
+		}
+		count = expected = wordLen;
+		m_stream->Read(&count, p);
+		if (count != expected) ReturnWithError(MissingData);
+		p += count;
 
-			if (type == SC_FSE) {
-				FSE_decompress(packedsign, 2048, tmpbuf, wordLen);
-			} else if (type == SC_FPC) {
-				FPC_decompress(packedsign, 2048, tmpbuf, wordLen);
-			} else if (type == SC_SRLE) {
-				sparserle_decomp(tmpbuf, packedsign, wordLen);
-			} else if (type == SC_SRLE_BIT) {
-				sparsebitrle_decomp(tmpbuf, packedsign, 2048);
-			} else {
-				LZ4_decompress_safe((const char *) tmpbuf,
-							(char *) packedsign,
-							wordLen, 2048);
+		if (patches) {
+			// read patches
+			count = expected = 1;
+			m_stream->Read(&count, p);
+			if (count != expected) ReturnWithError(MissingData);
+			count = expected = *p++*2*sizeof(UINT16);
+			m_stream->Read(&count, p);
+			if (count != expected) ReturnWithError(MissingData);
+			for (int i = 0; i < count; i += 2*sizeof(UINT16)) {
+				if (GetUINT16(p + i) >= BufferSize) ReturnWithError(FormatCannotRead);
 			}
+			p += count;
+		} else if (wide) {
+			// read high bytes of magnitudes
+			count = expected = 1 + sizeof(UINT16);
+			m_stream->Read(&count, p);
+			if (count != expected) ReturnWithError(MissingData);
+			wordLen = GetUINT16(p + 1);
+			if (!wordLen || !IsValidPlane(p[0], wordLen)) ReturnWithError(FormatCannotRead);
+			p += count;
+			count = expected = wordLen;
+			m_stream->Read(&count, p);
+			if (count != expected) ReturnWithError(MissingData);
+			p += count;
 		}
+	}
+
+	ASSERT(p - code <= CodeBufferLen*WordBytes);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Decompresses a byte plane of BufferSize values coded with the given block codec.
+// The codec has been checked by CDecoder::ReadMacroBlock. SC_NONE denotes an uncompressed plane.
+static void DecompressPlane(UINT8 type, const UINT8* in, UINT16 wordLen, UINT8* out) {
+	const BlockCodec *codec = FindBlockCodec(type, CodecPlaneAbs);
+	ASSERT(codec);
+	codec->decompress(in, wordLen, out, BufferSize);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Sign merge kernels: value[j] = (sign bit j) ? -magnitude[j] : magnitude[j]
+// with magnitude[j] = absbuf[j] | highbuf[j] << 8.
+// highbuf == nullptr: magnitudes below 256
+// signs == nullptr: all sign bits cleared, the magnitudes are zero-extended
+typedef void (*MergeSignsFunc)(const UINT8* absbuf, const UINT8* highbuf, const UINT8* signs, DataT* value);
+
+// Returns true if all bytes of the plane are zero.
+static bool IsZeroPlane(const UINT8* plane, UINT32 len) {
+	UINT8 any = 0;
+	for (UINT32 i = 0; i < len; i++) any |= plane[i];
+	return any == 0;
+}
 
-		// Unpack
-		const UINT64 xors[16] = {
+#if defined(PGF_SIMD) && !defined(__PGF32SUPPORT__)
+#define PGF_SIMD_SIGNS
+#endif
+
+#ifndef PGF_SIMD_SIGNS
+// Portable kernel: only used if the sign merge isn't vectorized
+static void MergeSignsScalar(const UINT8* absbuf, const UINT8* highbuf, const UINT8* signs, DataT* value) {
+	if (highbuf) {
+		for (UINT32 j = 0; j < BufferSize; j++) {
+			const DataT a = DataT(absbuf[j] | highbuf[j] << 8);
+			value[j] = (signs && ((signs[j / 8] >> (j % 8)) & 1)) ? -a : a;
+		}
+	} else {
+		// 64 bit SWAR: two's complement negation of 4 values with sign nibble s: (v ^ xors[s]) + adds[s]
+		static const UINT64 xors[16] = {
 			0,
 			0xffff,
 			0xffff0000,
@@ -686,7 +902,7 @@ void CDecoder::ReadMacroBlock(CMacroBlock* block) {
 			0xffffffffffff0000,
 			0xffffffffffffffff,
 		};
-		const UINT64 adds[16] = {
+		static const UINT64 adds[16] = {
 			0,
 			0x0001,
 			0x00010000,
@@ -707,7 +923,7 @@ void CDecoder::ReadMacroBlock(CMacroBlock* block) {
 
 		ptrunion u;
 		for (UINT32 j = 0; j < BufferSize; j += 8) {
-			UINT8 sign = packedsign[j / 8];
+			UINT8 sign = signs ? signs[j / 8] : 0;
 
 			UINT64 v = absbuf[j + 0] |
 					absbuf[j + 1] << 16 |
@@ -715,7 +931,7 @@ void CDecoder::ReadMacroBlock(CMacroBlock* block) {
 					(UINT64) absbuf[j + 3] << 48;
 			v ^= xors[sign % 16];
 			v += adds[sign % 16];
-			u.d = &block->m_value[j];
+			u.d = &value[j];
 			*u.p64 = v;
 
 			sign >>= 4;
@@ -726,43 +942,148 @@ void CDecoder::ReadMacroBlock(CMacroBlock* block) {
 					(UINT64) absbuf[j + 7] << 48;
 			v ^= xors[sign];
 			v += adds[sign];
-			u.d = &block->m_value[j + 4];
+			u.d = &value[j + 4];
 			*u.p64 = v;
 		}
+	}
+}
+#endif // !PGF_SIMD_SIGNS
+
+#ifdef PGF_SIMD_SIGNS
+// 8 values per iteration: negation with lane mask m is (a ^ m) - m
+static void MergeSignsSimd(const UINT8* absbuf, const UINT8* highbuf, const UINT8* signs, DataT* value) {
+	for (UINT32 j = 0; j < BufferSize; j += SimdLanes) {
+		SimdS16 a = highbuf ? SimdLoadBytes(absbuf + j, highbuf + j) : SimdLoadBytes(absbuf + j);
+		if (signs) {
+			const SimdS16 m = SimdExpandBits(signs[j / 8]);
+			a = SimdSub(SimdXor(a, m), m);
+		}
+		SimdStore(value + j, a);
+	}
+}
 
-		if (patches) {
-			UINT8 numpatches;
-			count = expected = 1;
-			m_stream->Read(&count, &numpatches);
-			if (count != expected) ReturnWithError(MissingData);
+#ifdef PGF_SIMD_AVX
+// 16 values per iteration
+__attribute__((target("avx2")))
+static void MergeSignsAVX2(const UINT8* absbuf, const UINT8* highbuf, const UINT8* signs, DataT* value) {
+	const __m256i weights = _mm256_setr_epi16(1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+		1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, (short)(1 << 15));
+	for (UINT32 j = 0; j < BufferSize; j += 16) {
+		__m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(absbuf + j)));
+		if (highbuf) {
+			a = _mm256_or_si256(a, _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(highbuf + j))), 8));
+		}
+		if (signs) {
+			const UINT32 bits = signs[j / 8] | signs[j / 8 + 1] << 8;
+			const __m256i m = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16((short)bits), weights), weights);
+			a = _mm256_sub_epi16(_mm256_xor_si256(a, m), m);
+		}
+		_mm256_storeu_si256((__m256i*)(value + j), a);
+	}
+}
 
-			UINT16 patchaddr;
-			INT16 patchval;
-			for (i = 0; i < numpatches; i++) {
-				count = expected = 2;
-				m_stream->Read(&count, &patchaddr);
-				patchaddr = __VAL(patchaddr);
-				if (count != expected) ReturnWithError(MissingData);
-				count = expected = 2;
-				m_stream->Read(&count, &patchval);
-				patchval = __VAL((UINT16) patchval);
-				if (count != expected) ReturnWithError(MissingData);
-				block->m_value[patchaddr] = patchval;
-			}
+// 32 values per iteration: the sign bits are directly used as write mask
+__attribute__((target("avx512f,avx512bw")))
+static void MergeSignsAVX512(const UINT8* absbuf, const UINT8* highbuf, const UINT8* signs, DataT* value) {
+	const __m512i zero = _mm512_setzero_si512();
+	for (UINT32 j = 0; j < BufferSize; j += 32) {
+		__m512i a = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(absbuf + j)));
+		if (highbuf) {
+			a = _mm512_or_si512(a, _mm512_slli_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(highbuf + j))), 8));
+		}
+		if (signs) {
+			__mmask32 k; // sign bit j of a little-endian load is bit j of the mask
+			memcpy(&k, signs + j / 8, sizeof(k));
+			a = _mm512_mask_sub_epi16(a, k, zero, a);
 		}
+		_mm512_storeu_si512(value + j, a);
 	}
+}
+#endif // PGF_SIMD_AVX
+#endif // PGF_SIMD_SIGNS
 
-	ASSERT(h.rbh.bufferSize == BufferSize);
-	block->m_valuePos = 0;
+//////////////////////////////////////////////////////////////////////
+// Selects the sign merge kernel of the widest instruction set supported by the CPU.
+static MergeSignsFunc SelectMergeSigns() {
+#if defined(PGF_SIMD_SIGNS) && defined(PGF_SIMD_AVX)
+	const SimdLevel level = SimdCpuLevel();
+	if (level == SimdAVX512) return MergeSignsAVX512;
+	if (level == SimdAVX2) return MergeSignsAVX2;
+#endif
+#ifdef PGF_SIMD_SIGNS
+	return MergeSignsSimd;
+#else
+	return MergeSignsScalar;
+#endif
+}
+
+static MergeSignsFunc MergeSigns() {
+	static const MergeSignsFunc merge = SelectMergeSigns(); // thread-safe initialization
+	return merge;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Decompresses the block record in the code buffer into m_value.
+// The block record has been read and checked by CDecoder::ReadMacroBlock.
+// Several macro blocks can be decompressed in parallel, all block codecs are reentrant.
+void CDecoder::CMacroBlock::Decompress() {
+	const UINT8 *in = m_code;
+	UINT8 absbuf[BufferSize], packedsign[2048];
+	const UINT8 *signs = packedsign;
+
+	UINT8 type = *in++;
+	UINT16 wordLen = GetUINT16(in);
+	in += sizeof(UINT16);
+
+	if (!wordLen) {
+		memset(m_value, 0, sizeof(DataT) * BufferSize);
+	} else {
+		DecompressPlane(type, in, wordLen, absbuf);
+		in += wordLen;
+
+		const bool patches = *in & SCFLAG_PATCHES;
+		const bool wide = *in & SCFLAG_WIDE;
+		type = *in++ & ~(SCFLAG_PATCHES | SCFLAG_WIDE);
+
+		if (type == SC_NONE) {
+			signs = in;
+			in += 2048;
+		} else {
+			wordLen = GetUINT16(in);
+			in += sizeof(UINT16);
+
+			const BlockCodec *codec = FindBlockCodec(type, CodecPlaneSign);
+			ASSERT(codec);
+			codec->decompress(in, wordLen, packedsign, 2048);
+			in += wordLen;
+		}
+
+		UINT8 highbuf[BufferSize];
+		if (wide) {
+			// magnitudes above 255: combine with the plane of high bytes
+			DecompressPlane(in[0], in + 1 + sizeof(UINT16), GetUINT16(in + 1), highbuf);
+		}
+		MergeSigns()(absbuf, wide ? highbuf : nullptr, IsZeroPlane(signs, 2048) ? nullptr : signs, m_value);
+		if (wide) return;
+
+		if (patches) {
+			const UINT8 numpatches = *in++;
+			for (UINT32 i = 0; i < numpatches; i++) {
+				const UINT16 patchaddr = GetUINT16(in);
+				m_value[patchaddr] = (INT16) GetUINT16(in + sizeof(UINT16));
+				in += 2*sizeof(UINT16);
+			}
+		}
+	}
 }
 
 #ifdef __PGFROISUPPORT__
 //////////////////////////////////////////////////////////////////////
 // Resets stream position to next tile.
 // Used with ROI encoding scheme only.
-// Reads several next blocks from stream but doesn't decode them into macro blocks
-// Encoding scheme: <wordLen>(16 bits) ROI data
-//		ROI	  ::= <bufferSize>(15 bits) <eofTile>(1 bit)
+// Reads the block headers of the next blocks and skips their block records until the end of the tile.
+// Encoding scheme: <blockLen>(16 bits) ROI Block
+//		ROI	  ::= <bufferSize>(15 bits) <tileEnd>(1 bit)
 // It might throw an IOException.
 void CDecoder::SkipTileBuffer() {
 	ASSERT(m_roi);
@@ -785,29 +1106,83 @@ void CDecoder::SkipTileBuffer() {
 
 	ASSERT(m_macroBlocksAvailable <= 0);
 	m_macroBlocksAvailable = 0;
-	UINT16 wordLen;
+	SkipTileRecords();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Skips the block records of the tile at the current stream position.
+// Reads the block headers only and sets the stream position behind the block record with tile-end = true.
+// It might throw an IOException.
+void CDecoder::SkipTileRecords() {
+	ASSERT(m_roi);
+	UINT16 prefix[2];
 	ROIBlockHeader h(0);
 	int count, expected;
 
 	// skips all blocks until tile end
 	do {
-		// read wordLen
-		count = expected = sizeof(wordLen);
-		m_stream->Read(&count, &wordLen);
+		// read blockLen and ROIBlockHeader
+		count = expected = sizeof(prefix);
+		m_stream->Read(&count, prefix);
 		if (count != expected) ReturnWithError(MissingData);
-		wordLen = __VAL(wordLen); // convert wordLen
-		if (wordLen > BufferSize) ReturnWithError(FormatCannotRead);
+		const UINT16 blockLen = __VAL(prefix[0]);
+		h.val = __VAL(prefix[1]); // convert ROIBlockHeader
+		if (blockLen > CodeBufferLen*WordBytes || h.rbh.bufferSize > BufferSize) ReturnWithError(FormatCannotRead);
 
-		// read ROIBlockHeader
-		count = expected = sizeof(ROIBlockHeader);
-		m_stream->Read(&count, &h.val);
-		if (count != expected) ReturnWithError(MissingData);
-		h.val = __VAL(h.val); // convert ROIBlockHeader
-
-		// skip data
-		m_stream->SetPos(FSFromCurrent, wordLen*WordBytes);
+		// skip block record without reading it
+		m_stream->SetPos(FSFromCurrent, blockLen);
 	} while (!h.rbh.tileEnd);
 }
+
+//////////////////////////////////////////////////////////////////////
+// Reads the block records of the next tile and returns a new decoder of this tile.
+// If the stream provides direct access to its data (see CPGFStream::GetData),
+// the block records are not copied: the tile decoder refers to the stream data instead.
+// It might throw an IOException.
+CDecoder* CDecoder::ReadTile() {
+	ASSERT(m_roi);
+	ASSERT(m_macroBlocksAvailable <= 0);
+
+	// find the end of the tile
+	const UINT64 startPos = m_stream->GetPos();
+	SkipTileRecords();
+	const UINT64 len = m_stream->GetPos() - startPos;
+	m_stream->SetPos(FSFromStart, startPos);
+
+	CPGFMemoryStream *tileStream;
+	UINT64 available;
+	const UINT8 *data = m_stream->GetData(available);
+	if (data) {
+		// zero-copy
+		if (available < len) ReturnWithError2(MissingData, nullptr);
+		tileStream = new(std::nothrow) CPGFMemoryStream(const_cast<UINT8*>(data), (size_t)len);
+		m_stream->SetPos(FSFromCurrent, len);
+	} else {
+		tileStream = new(std::nothrow) CPGFMemoryStream((size_t)len);
+		if (tileStream) {
+			int count = (int)len;
+			try {
+				m_stream->Read(&count, tileStream->GetBuffer());
+			} catch (IOException&) {
+				delete tileStream;
+				throw;
+			}
+			tileStream->SetEOS(count);
+			if ((UINT64)count != len) {
+				delete tileStream;
+				ReturnWithError2(MissingData, nullptr);
+			}
+		}
+	}
+	if (!tileStream) ReturnWithError2(InsufficientMemory, nullptr);
+
+	CDecoder *tile = new(std::nothrow) CDecoder(tileStream);
+	if (!tile) {
+		delete tileStream;
+		ReturnWithError2(InsufficientMemory, nullptr);
+	}
+	return tile;
+}
 #endif
 
 //////////////////////////////////////////////////////////////////////
@@ -57,6 +57,7 @@ class CDecoder {
 #pragma warning( suppress : 4351 )
 		, m_value()
 		, m_codeBuffer()
+		, m_code((const UINT8*)m_codeBuffer)
 		, m_valuePos(0)
 		, m_sigFlagVector()
 		{
@@ -73,9 +74,16 @@ class CDecoder {
 		/// Call CDecoder::ReadMacroBlock before this method.
 		void BitplaneDecode();
 
+		//////////////////////////////////////////////////////////////////////
+		/// Decompresses already read block record (m_code) into this macro block.
+		/// Several macro blocks can be decompressed in parallel.
+		/// Call CDecoder::ReadMacroBlock before this method.
+		void Decompress();
+
 		ROIBlockHeader m_header;					///< block header
 		DataT  m_value[BufferSize] __attribute__((aligned(8)));					///< output buffer of values with index m_valuePos
-		UINT32 m_codeBuffer[CodeBufferLen];			///< input buffer for encoded bitstream
+		UINT32 m_codeBuffer[CodeBufferLen];			///< input buffer for encoded bitstream (block record)
+		const UINT8 *m_code;						///< block record: m_codeBuffer or stream data (zero-copy)
 		UINT32 m_valuePos;							///< current position in m_value
 
 	private:
@@ -171,6 +179,15 @@ public:
 	/// It might throw an IOException.
 	void DecodeBuffer();
 
+	/////////////////////////////////////////////////////////////////////
+	/// Reads and decompresses exactly one block record at the current stream position.
+	/// In contrast to DecodeBuffer, no further block records are read ahead.
+	/// The returned values are valid until the next block is decoded.
+	/// It might throw an IOException.
+	/// @param header [out] ROI block header of the block record
+	/// @return BufferSize decoded values
+	const DataT* DecodeBlock(ROIBlockHeader& header);
+
 	/////////////////////////////////////////////////////////////////////
 	/// @return Stream
 	CPGFStream* GetStream()							{ return m_stream; }
@@ -187,6 +204,15 @@ public:
 	/// It might throw an IOException.
 	void SkipTileBuffer();
 
+	/////////////////////////////////////////////////////////////////////
+	/// Reads the block records of the next tile and returns a new decoder of this tile.
+	/// A tile decoder is independent of this decoder and of its stream, hence several tiles
+	/// can be decoded concurrently, each with its own tile decoder.
+	/// Used with ROI encoding scheme only.
+	/// It might throw an IOException.
+	/// @return A tile decoder, the caller has to delete it
+	CDecoder* ReadTile();
+
 	/////////////////////////////////////////////////////////////////////
 	/// Enables region of interest (ROI) status.
 	void SetROI()					{ m_roi = true; }
@@ -197,6 +223,10 @@ public:
 #endif
 
 private:
+#ifdef __PGFROISUPPORT__
+	CDecoder(CPGFStream* tileStream);
+	void SkipTileRecords(); ///< throws IOException
+#endif
 	void ReadMacroBlock(CMacroBlock* block); ///< throws IOException
 
 	CPGFStream *m_stream;						///< input PGF stream
@@ -212,6 +242,7 @@ private:
 
 #ifdef __PGFROISUPPORT__
 	bool   m_roi;								///< true: ensures region of interest (ROI) decoding
+	bool   m_tileDecoder;						///< true: decoder of a single tile, owns its stream (see ReadTile)
 #endif
 };
 
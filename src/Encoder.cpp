@@ -27,17 +27,20 @@
 /// @author C. Stamm, R. Spuler
 
 #include "Encoder.h"
+#include "BlockCodec.h"
+#include "SIMD.h"
 #ifdef TRACE
 	#include <stdio.h>
 #endif
 
-#include "bitpack/bitpack.h"
-#include "fpc/fpc.h"
-#include "fse/fse.h"
+#include <limits.h>
+#include <math.h>
+
+extern "C" {
+#include "fse/hist.h"
+}
+#include "lz4/lz4.h"
 #include "lz4/lz4hc.h"
-#include "srle/sparserle.h"
-#include "tunstall/tunstall.h"
-#include "zeropack/zeropack.h"
 
 //////////////////////////////////////////////////////
 // PGF: file structure
@@ -81,6 +84,7 @@ CEncoder::CEncoder(CPGFStream* stream, PGFPreHeader preHeader, PGFHeader header,
 , m_currLevelIndex(0)
 , m_nLevels(header.nLevels)
 , m_favorSpeed(false)
+, m_effort(DefaultEncoderEffort)
 , m_forceWriting(false)
 #ifdef __PGFROISUPPORT__
 , m_roi(false)
@@ -89,30 +93,7 @@ CEncoder::CEncoder(CPGFStream* stream, PGFPreHeader preHeader, PGFHeader header,
 	ASSERT(m_stream);
 
 	int count;
-	m_lastMacroBlock = 0;
-	m_levelLength = nullptr;
-
-	// set number of threads
-#ifdef LIBPGF_USE_OPENMP
-	m_macroBlockLen = omp_get_num_procs();
-#else
-	m_macroBlockLen = 1;
-#endif
-
-	if (useOMP && m_macroBlockLen > 1) {
-#ifdef LIBPGF_USE_OPENMP
-		omp_set_num_threads(m_macroBlockLen);
-#endif
-		// create macro block array
-		m_macroBlocks = new(std::nothrow) CMacroBlock*[m_macroBlockLen];
-		if (!m_macroBlocks) ReturnWithError(InsufficientMemory);
-		for (int i=0; i < m_macroBlockLen; i++) m_macroBlocks[i] = new CMacroBlock(this);
-		m_currentBlock = m_macroBlocks[m_lastMacroBlock++];
-	} else {
-		m_macroBlocks = 0;
-		m_macroBlockLen = 1;
-		m_currentBlock = new CMacroBlock(this);
-	}
+	InitMacroBlocks(useOMP);
 
 	// save file position
 	m_startPosition = m_stream->GetPos();
@@ -150,6 +131,64 @@ CEncoder::CEncoder(CPGFStream* stream, PGFPreHeader preHeader, PGFHeader header,
 	m_levelLengthPos = m_stream->GetPos();
 }
 
+/////////////////////////////////////////////////////////////////////
+/// Constructor of an encoder writing the levels of an image whose headers are already in the stream.
+/// The stream position has to be at the beginning of the level lengths (see WriteLevelLength).
+/// Used to recode the block records of an existing image (see CPGFImage::Recompress).
+/// It might throw an IOException.
+/// @param stream A PGF stream
+/// @param header The already written PGF header
+/// @param useOMP If true, then the encoder will use multi-threading based on openMP
+CEncoder::CEncoder(CPGFStream* stream, const PGFHeader& header, bool useOMP)
+: m_stream(stream)
+, m_bufferStartPos(0)
+, m_currLevelIndex(0)
+, m_nLevels(header.nLevels)
+, m_favorSpeed(false)
+, m_effort(DefaultEncoderEffort)
+, m_forceWriting(false)
+#ifdef __PGFROISUPPORT__
+, m_roi(false)
+#endif
+{
+	ASSERT(m_stream);
+
+	InitMacroBlocks(useOMP);
+
+	// save file position
+	m_startPosition = m_levelLengthPos = m_stream->GetPos();
+}
+
+//////////////////////////////////////////////////////
+// Create the macro blocks used by the constructors.
+// It might throw an IOException.
+void CEncoder::InitMacroBlocks(bool useOMP) {
+	m_lastMacroBlock = 0;
+	m_levelLength = nullptr;
+
+	// set number of threads
+#ifdef LIBPGF_USE_OPENMP
+	m_macroBlockLen = omp_get_num_procs();
+#else
+	m_macroBlockLen = 1;
+#endif
+
+	if (useOMP && m_macroBlockLen > 1) {
+#ifdef LIBPGF_USE_OPENMP
+		omp_set_num_threads(m_macroBlockLen);
+#endif
+		// create macro block array
+		m_macroBlocks = new(std::nothrow) CMacroBlock*[m_macroBlockLen];
+		if (!m_macroBlocks) ReturnWithError(InsufficientMemory);
+		for (int i=0; i < m_macroBlockLen; i++) m_macroBlocks[i] = new CMacroBlock(this);
+		m_currentBlock = m_macroBlocks[m_lastMacroBlock++];
+	} else {
+		m_macroBlocks = 0;
+		m_macroBlockLen = 1;
+		m_currentBlock = new CMacroBlock(this);
+	}
+}
+
 //////////////////////////////////////////////////////
 // Destructor
 CEncoder::~CEncoder() {
@@ -340,16 +379,39 @@ void CEncoder::WriteValue(CSubband* band, int bandPos) {
 	if (v > m_currentBlock->m_maxAbsValue) m_currentBlock->m_maxAbsValue = v;
 }
 
+/////////////////////////////////////////////////////////////////////
+// Compresses the values of a decoded block record again and writes the block into stream.
+// The block record is compressed with the codec selection of the current effort level.
+// A completed level forces writing, like SetEncodedLevel.
+// It might throw an IOException.
+void CEncoder::RecodeBlock(const DataT* value, ROIBlockHeader h, int lastLevelIndex) {
+	ASSERT(value);
+	ASSERT(m_currentBlock->m_valuePos == 0);
+	ASSERT(lastLevelIndex >= m_currentBlock->m_lastLevelIndex && lastLevelIndex < m_nLevels);
+
+	memcpy(m_currentBlock->m_value, value, BufferSize*DataTSize);
+	m_currentBlock->m_valuePos = h.rbh.bufferSize;
+	if (lastLevelIndex != m_currentBlock->m_lastLevelIndex) {
+		m_currentBlock->m_lastLevelIndex = lastLevelIndex;
+		m_forceWriting = true;
+	}
+	EncodeBuffer(h);
+}
+
 /////////////////////////////////////////////////////////////////////
 // Encode buffer and write data into stream.
 // h contains buffer size and flag indicating end of tile.
-// Encoding scheme: <wordLen>(16 bits) [ ROI ] data
-//		ROI	  ::= <bufferSize>(15 bits) <eofTile>(1 bit)
+// Encoding scheme: [ <blockLen>(16 bits) ROI ] Block (see WriteMacroBlock)
+//		ROI	  ::= <bufferSize>(15 bits) <tileEnd>(1 bit)
 // It might throw an IOException.
 void CEncoder::EncodeBuffer(ROIBlockHeader h) {
 	ASSERT(m_currentBlock);
 #ifdef __PGFROISUPPORT__
 	ASSERT(m_roi && h.rbh.bufferSize <= BufferSize || h.rbh.bufferSize == BufferSize);
+	if (h.rbh.bufferSize < BufferSize) {
+		// partial buffer at the end of a tile: don't code stale values of the previous buffer
+		memset(&(m_currentBlock->m_value[h.rbh.bufferSize]), 0, (BufferSize - h.rbh.bufferSize)*DataTSize);
+	}
 #else
 	ASSERT(h.rbh.bufferSize == BufferSize);
 #endif
@@ -357,7 +419,7 @@ void CEncoder::EncodeBuffer(ROIBlockHeader h) {
 
 	// macro block management
 	if (m_macroBlockLen == 1) {
-		//m_currentBlock->BitplaneEncode();
+		m_currentBlock->Compress();
 		WriteMacroBlock(m_currentBlock);
 	} else {
 		// save last level index
@@ -388,12 +450,14 @@ void CEncoder::EncodeBuffer(ROIBlockHeader h) {
 			}
 			if (error != NoError) ReturnWithError(error);
 			*/
+			// codec trials run in parallel, each block into its own code buffer
 #ifdef LIBPGF_USE_OPENMP
 			#pragma omp parallel for default(shared) //no declared exceptions in next block
 #endif
 			for (int i=0; i < m_lastMacroBlock; i++) {
-				m_macroBlocks[i]->BitplaneEncode();
+				m_macroBlocks[i]->Compress();
 			}
+			// stream writes remain sequential to keep the block order
 			for (int i=0; i < m_lastMacroBlock; i++) {
 				WriteMacroBlock(m_macroBlocks[i]);
 			}
@@ -408,198 +472,377 @@ void CEncoder::EncodeBuffer(ROIBlockHeader h) {
 	}
 }
 
-/////////////////////////////////////////////////////////////////////
-// Write encoded macro block into stream.
-// It might throw an IOException.
-void CEncoder::WriteMacroBlock(CMacroBlock* block) {
-	ASSERT(block);
-
-#ifdef TRACE
-	//UINT32 filePos = (UINT32)m_stream->GetPos();
-	//printf("EncodeBuffer: %d\n", filePos);
-#endif
-
-	UINT8 absbuf[16384], packedsign[2048], zopbuf[32768],
-		rlebuf[16384], rlebitbuf[16384], zprbuf[16384],
-		tunstallbuf[16384 + 768], bpbuf[16384], sb2buf[16384];
-	unsigned i, zerocheck = 0, numpatches = 0;
-	#define MAX_PATCH 64
-	UINT16 patchaddr[MAX_PATCH];
-	INT16 patchval[MAX_PATCH];
+//////////////////////////////////////////////////////
+// Codec selection: cost model
+//
+// A cheap signature of a block (histogram, zero ratio, maximum value, run
+// statistics) is used to predict the compressed size of each codec. The sizes of
+// the simple codecs (SRLE, SRLE_BIT, SB2, BP) are computed exactly, the sizes of
+// the entropy coders (FSE, FPC, ZP) are estimated from order-0 entropies, and
+// the size of LZ4 HC is derived from the fast LZ4 compressor.
+// Only the best predictions are really compressed. The effort level of the
+// encoder defines the allowed codecs and the number of candidates, the codec
+// table (see BlockCodec.h) the enabled codecs and the order of the trials.
+
+#define FastAbsCodecs			(CodecBit(SC_FSE) | CodecBit(SC_SRLE) | CodecBit(SC_SRLE_BIT) | CodecBit(SC_BP) | CodecBit(SC_SB2))
+#define ModelAbsCodecs			(FastAbsCodecs | CodecBit(SC_FPC) | CodecBit(SC_ZP))
+#define AbsCodecs				(ModelAbsCodecs | CodecBit(SC_TUNSTALL))
+#define FastSignCodecs			(CodecBit(SC_FSE) | CodecBit(SC_SRLE) | CodecBit(SC_SRLE_BIT))
+#define SignCodecs				(FastSignCodecs | CodecBit(SC_LZ4) | CodecBit(SC_FPC))
+#define PlaneBufferLen			(3*16384)	///< worst case output length of all block codecs for a byte plane
+#define MaxPatches				255		///< maximum number of patched magnitudes in a block record
+#define MinWideValues			16		///< below this number of magnitudes above 255 patches are always used
+#define NoSize					NoCodecSize
+#define SegmentLen				512		///< histogram segment length of the FPC model
+#define SegmentOverhead			20		///< estimated table size of a FPC block
 
-	memset(packedsign, 0, 2048);
-	for (i = 0; i < 16384; i++) {
-		absbuf[i] = abs(block->m_value[i]);
-		packedsign[i / 8] |= (block->m_value[i] < 0 ? 1 : 0) << (i % 8);
+//////////////////////////////////////////////////////
+// Encoder effort level
+struct EffortLevel {
+	UINT32 absCodecs;		///< allowed codecs of magnitude planes
+	UINT32 signCodecs;		///< allowed codecs of sign planes
+	UINT32 candidates;		///< number of tried codecs per plane; 0: all allowed codecs are tried
+	UINT32 marginShift;		///< a further candidate is tried if its prediction is at most best + (best >> marginShift)
+	int lz4Level;			///< LZ4 HC compression level
+	unsigned fseTableLog;	///< maximum FSE table log: 9 or 10 (FSE default); FSE overflows its work space with smaller logs and large alphabets
+};
+
+static const EffortLevel EffortLevels[MaxEncoderEffort + 1] = {
+	{ FastAbsCodecs,						FastSignCodecs,							1, 4, LZ4HC_CLEVEL_MIN,		9 },
+	{ FastAbsCodecs,						FastSignCodecs,							2, 4, LZ4HC_CLEVEL_MIN,		9 },
+	{ FastAbsCodecs | CodecBit(SC_ZP),		FastSignCodecs | CodecBit(SC_LZ4),		2, 4, LZ4HC_CLEVEL_MIN,		10 },
+	{ ModelAbsCodecs,						SignCodecs,								1, 4, LZ4HC_CLEVEL_DEFAULT,	10 },
+	{ ModelAbsCodecs,						SignCodecs,								2, 4, LZ4HC_CLEVEL_DEFAULT,	10 },
+	{ ModelAbsCodecs,						SignCodecs,								2, 4, LZ4HC_CLEVEL_MAX,		10 },	// default
+	{ ModelAbsCodecs,						SignCodecs,								3, 3, LZ4HC_CLEVEL_MAX,		10 },
+	{ ModelAbsCodecs,						SignCodecs,								4, 2, LZ4HC_CLEVEL_MAX,		10 },
+	{ ModelAbsCodecs,						SignCodecs,								0, 0, LZ4HC_CLEVEL_MAX,		10 },
+	{ AbsCodecs,							SignCodecs,								0, 0, LZ4HC_CLEVEL_MAX,		10 },	// exhaustive search
+};
 
-		zerocheck |= absbuf[i] | packedsign[i / 8];
+//////////////////////////////////////////////////////
+// Block signature used by the cost model
+struct BlockSignature {
+	UINT32 len;				///< block length in bytes
+	unsigned count[256];	///< histogram
+	unsigned maxValue;		///< largest value in block
+	UINT32 used;			///< number of different values
+	UINT32 zeros;			///< number of zeros
+	UINT32 runs;			///< number of runs of equal values
+	double entropy;			///< order-0 entropy in bytes
+	double nonZeroEntropy;	///< order-0 entropy of the non-zero values in bytes
+	UINT32 fpcSize;			///< estimated SC_FPC size
+	UINT32 srleSize;		///< exact SC_SRLE size
+	UINT32 srleBitSize;		///< exact SC_SRLE_BIT size
+	UINT32 sb2Size;			///< exact SC_SB2 size
+	UINT32 bpSize;			///< exact SC_BP size
+	UINT32 zpBitmapSize;	///< estimated size of the ZP non-zero bitmap
+	UINT32 lz4Size;			///< estimated SC_LZ4 size (sign planes only)
+};
+
+// number of bits needed to store val
+static inline UINT32 NeededBits(UINT32 val) {
+	UINT32 bits = 0;
+	while (val) { bits++; val >>= 1; }
+	return bits;
+}
 
-		if (abs(block->m_value[i]) > 255) {
-			/*printf("Need patch %u/%u at %u (%d), max %u\n", numpatches,
-				MAX_PATCH,
-				i, block->m_value[i], m_currentBlock->m_maxAbsValue);*/
-			if (numpatches >= MAX_PATCH)
-				abort();
+// order-0 entropy in bytes of a histogram with n entries
+static double Entropy(const unsigned* count, unsigned maxValue, UINT32 n) {
+	double h = 0;
+	for (unsigned i = 0; i <= maxValue; i++) {
+		if (count[i]) h += count[i]*log2(double(n)/count[i]);
+	}
+	return h/8;
+}
 
-			absbuf[i] = 1; // to avoid the -256 "minus zero"
+// estimated Huffman size in bytes of a segment with n values, at least one bit per value
+static UINT32 SegmentCost(const unsigned* count, const UINT8* symbols, UINT32 used, UINT32 n) {
+	double h = 0;
+	UINT32 nonEmpty = 0;
+	for (UINT32 i = 0; i < used; i++) {
+		const unsigned c = count[symbols[i]];
+		if (c) {
+			nonEmpty++;
+			h += c*log2(double(n)/c);
+		}
+	}
+	if (nonEmpty <= 1) return 5;
+	h /= 8;
+	return ((h > n/8) ? UINT32(h) : n/8) + SegmentOverhead;
+}
 
-			UINT16 tmp = i;
-			patchaddr[numpatches] = __VAL(tmp);
-			patchval[numpatches] = __VAL((UINT16) block->m_value[i]);
+//////////////////////////////////////////////////////
+// Compute signature of a block. len has to be a power of 2 and at least SegmentLen.
+static void ComputeSignature(const UINT8* in, UINT32 len, BlockSignature& sig) {
+	ASSERT(len % SegmentLen == 0);
+	const UINT32 nSegments = len/SegmentLen;
+	unsigned segCount[BufferSize/SegmentLen][256];
+	UINT32 segSize[BufferSize/SegmentLen];
+	UINT8 symbols[256];
+	UINT32 i, k;
+
+	ASSERT(nSegments <= BufferSize/SegmentLen);
+	sig.len = len;
+	memset(sig.count, 0, sizeof(sig.count));
+	sig.maxValue = 0;
+	for (k = 0; k < nSegments; k++) {
+		unsigned maxValue = 255;
+		HIST_count(segCount[k], &maxValue, in + k*SegmentLen, SegmentLen);
+		for (i = maxValue + 1; i < 256; i++) segCount[k][i] = 0;
+		for (i = 0; i <= maxValue; i++) sig.count[i] += segCount[k][i];
+		if (maxValue > sig.maxValue) sig.maxValue = maxValue;
+	}
 
-			numpatches++;
+	UINT8 orBits = 0;
+	sig.used = 0;
+	for (i = 0; i <= sig.maxValue; i++) {
+		if (sig.count[i]) {
+			symbols[sig.used++] = UINT8(i);
+			orBits |= i;
 		}
 	}
 
-	if (zerocheck) {
-		size_t best;
-		size_t outsize = FSE_compress(zopbuf, 32768, absbuf, 16384);
-		const size_t mainfpc = FPC_compress(zopbuf + 16384, absbuf, 16384, 0);
-		uint16_t rlesize = sparserle_comp(absbuf, rlebuf, 16384);
-		uint16_t rlebitsize = sparsebitrle_comp(absbuf, rlebitbuf, 16384);
-		const uint16_t zprsize = zeropack_comp_rec(absbuf, zprbuf, 16384);
-		const uint16_t tunstallsize = tunstall_comp(absbuf, tunstallbuf, 16384);
-		const uint16_t bpsize = bitpack_comp(absbuf, bpbuf, 16384);
-		const uint16_t sb2size = sb2_comp(absbuf, sb2buf, 16384);
-		if (outsize < 2)
-			abort();
-
-		best = outsize;
-		SignCompression type = SC_FSE;
-		if (mainfpc < best) {
-			type = SC_FPC;
-			best = mainfpc;
-		}
-		if (zprsize < best) {
-			type = SC_ZP;
-			best = zprsize;
+	// FPC chooses its Huffman block lengths adaptively: merge neighbouring
+	// segments bottom-up as long as a common code table is cheaper
+	for (k = 0; k < nSegments; k++) {
+		segSize[k] = SegmentCost(segCount[k], symbols, sig.used, SegmentLen);
+	}
+	for (UINT32 n = nSegments/2, segLen = 2*SegmentLen; n > 0; n /= 2, segLen *= 2) {
+		for (k = 0; k < n; k++) {
+			for (i = 0; i < sig.used; i++) {
+				segCount[k][symbols[i]] = segCount[2*k][symbols[i]] + segCount[2*k + 1][symbols[i]];
+			}
+			const UINT32 merged = SegmentCost(segCount[k], symbols, sig.used, segLen);
+			const UINT32 split = segSize[2*k] + segSize[2*k + 1];
+			segSize[k] = (merged < split) ? merged : split;
 		}
-		if (tunstallsize < best) {
-			type = SC_TUNSTALL;
-			best = tunstallsize;
+	}
+	sig.fpcSize = segSize[0];
+	sig.zeros = sig.count[0];
+	sig.entropy = Entropy(sig.count, sig.maxValue, len);
+	sig.nonZeroEntropy = 0;
+	if (sig.zeros < len) {
+		sig.count[0] = 0;
+		sig.nonZeroEntropy = Entropy(sig.count, sig.maxValue, len - sig.zeros);
+		sig.count[0] = sig.zeros;
+	}
+
+	// SC_SRLE_BIT counts a zero as a value only if it is not part of a run
+	UINT32 usedBit = sig.used - (sig.zeros ? 1 : 0);
+	for (i = 0; i < len; i++) {
+		if (!in[i] && (!i || in[i - 1]) && (i == len - 1 || in[i + 1])) {
+			usedBit++;
+			break;
 		}
-		if (bpsize < best) {
-			type = SC_BP;
-			best = bpsize;
+	}
+
+	// run statistics: mirror the run-length codecs
+	const UINT32 sb2Bits = NeededBits(sig.used - 1);
+	const UINT32 bitLen = NeededBits(usedBit + 3);
+	UINT32 srle = 1, srleBits = 0, sb2Len = 0;
+	bool wasByte = false;
+
+	sig.runs = 0;
+	for (i = 0; i < len; ) {
+		const UINT8 val = in[i];
+		UINT32 end = i + 1;
+		while (end < len && in[end] == val) end++;
+		const UINT32 run = end - i;
+		sig.runs++;
+
+		if (run == 1) {
+			srle++;
+			srleBits += bitLen;
+			wasByte = val != 0;
+		} else {
+			srle += (wasByte ? 0 : 1) + (val ? 1 : 0) + (run < 128 ? 1 : 2);
+			srleBits += (val ? 2*bitLen : bitLen) + (run < 256 ? 8 : 14);
+			wasByte = false;
 		}
-		if (rlebitsize < best + 16) {
-			type = SC_SRLE_BIT;
-			best = rlebitsize;
+		if (val) {
+			sb2Len += sb2Bits*run;
+		} else {
+			// zero runs are split into pieces of at most 2048
+			UINT32 rest = run;
+			while (rest) {
+				const UINT32 r = rest - 1;
+				sb2Len += sb2Bits;
+				if (r < 32) {
+					sb2Len += 6; rest = 0;
+				} else if (r < 2047) {
+					sb2Len += 12; rest = 0;
+				} else if (r == 2047) {
+					sb2Len += 12 + sb2Bits + 6; rest = 0;
+				} else {
+					sb2Len += 12; rest -= 2048;
+				}
+			}
 		}
-		if (sb2size < best + 16) {
-			type = SC_SB2;
-			best = sb2size;
+		i = end;
+	}
+	sig.srleSize = (sig.zeros && __builtin_popcount(UINT8(~orBits)) >= 2 && sig.used <= 32) ? srle : NoSize;
+	sig.srleBitSize = (usedBit <= 28) ? 1 + usedBit + (srleBits + 7)/8 : NoSize;
+	sig.sb2Size = (sig.used <= 32) ? 1 + sig.used + (sb2Len + 7)/8 : NoSize;
+
+	// bit packing with 3 or 4 bits, rare values are patched
+	{
+		const UINT32 limit = len/256;
+		UINT32 patchUsed = 0, numVals = 0, numPatches = 0, cumPatches = 0;
+		for (i = 0; i < 256; i++) {
+			if (sig.count[i] >= limit) patchUsed++;
 		}
-		if (rlesize < best + 16) {
-			type = SC_SRLE;
-			best = rlesize;
+		const bool patching = NeededBits(patchUsed - 1) != NeededBits(sig.used - 1) && NeededBits(sig.used - 1) > 3;
+		if (patchUsed > 16 || (!patching && sig.used > 16)) {
+			sig.bpSize = NoSize;
+		} else {
+			for (i = 0; i <= sig.maxValue; i++) {
+				if (!sig.count[i]) continue;
+				if (patching && sig.count[i] < limit) {
+					numPatches++;
+					cumPatches += sig.count[i];
+				} else {
+					numVals++;
+				}
+			}
+			sig.bpSize = 2 + numVals + (patching ? 2*(numPatches + cumPatches) : 0) + (numVals > 8 ? len/2 : len*3/8);
 		}
+	}
 
-		int count = 1;
-		m_stream->Write(&count, &type);
-
-		count = sizeof(UINT16);
-		best = __VAL((UINT16) best);
-		m_stream->Write(&count, &best);
-		count = __VAL((UINT16) best);
-		if (type == SC_FSE) {
-			m_stream->Write(&count, zopbuf);
-		} else if (type == SC_ZP) {
-			m_stream->Write(&count, zprbuf);
-		} else if (type == SC_TUNSTALL) {
-			m_stream->Write(&count, tunstallbuf);
-		} else if (type == SC_BP) {
-			m_stream->Write(&count, bpbuf);
-		} else if (type == SC_SRLE) {
-			m_stream->Write(&count, rlebuf);
-		} else if (type == SC_SRLE_BIT) {
-			m_stream->Write(&count, rlebitbuf);
-		} else if (type == SC_SB2) {
-			m_stream->Write(&count, sb2buf);
-		} else {
-			m_stream->Write(&count, zopbuf + 16384);
+	// zero pack bitmap: non-zero groups of 8 and 64 values
+	{
+		UINT32 n8 = 0, n64 = 0;
+		UINT8 any64 = 0;
+		for (i = 0; i < len; i += 8) {
+			UINT64 v;
+			memcpy(&v, in + i, 8);
+			const UINT8 any = v != 0;
+			n8 += any; any64 |= any;
+			if ((i + 8) % 64 == 0) { n64 += any64; any64 = 0; }
 		}
+		const UINT32 level0 = len/8;
+		sig.zpBitmapSize = (n8 >= level0*7/8) ? 1 + level0 : 1 + n8 + ((n64 < len/64) ? len/512 + n64 : len/64);
+	}
+}
 
-		const size_t lz4len = LZ4_compress_HC((const char *) packedsign,
-							(char *) zopbuf,
-							2048, 16384, 16);
-		const size_t fselen = FSE_compress(zopbuf + 16384, 16384, packedsign, 2048);
-		const size_t fpclen = FPC_compress(zopbuf + 24 * 1024, packedsign, 2048, 0);
-		rlesize = sparserle_comp(packedsign, rlebuf, 2048);
-		rlebitsize = sparsebitrle_comp(packedsign, rlebitbuf, 2048);
+//////////////////////////////////////////////////////
+// Predict the size of a codec from a block signature.
+// Returns NoSize if the codec cannot handle the block or if there is no model for it.
+static UINT32 PredictSize(const BlockSignature& sig, SignCompression sc) {
+	switch (sc) {
+	case SC_FSE:
+		return UINT32(sig.entropy) + sig.used + 2;
+	case SC_LZ4:
+		return sig.lz4Size;
+	case SC_FPC:
+		return sig.fpcSize;
+	case SC_ZP:
+		if (sig.zeros < sig.len/8 || sig.used < 3 || sig.used > 101) return NoSize;
+		// Huffman coded non-zero values need at least one bit each
+		return sig.zpBitmapSize + __max(UINT32(sig.nonZeroEntropy*1.02), (sig.len - sig.zeros)/8) + sig.used + 12;
+	case SC_SRLE:
+		return sig.srleSize;
+	case SC_SRLE_BIT:
+		return sig.srleBitSize;
+	case SC_SB2:
+		return sig.sb2Size;
+	case SC_BP:
+		return sig.bpSize;
+	default:
+		return NoSize;
+	}
+}
 
-		// Sometimes LZ4 beats FSE, sometimes it's incompressible
-		type = SC_NONE;
-		best = 2028; // 2048 minus overhead heuristic
+//////////////////////////////////////////////////////
+// Select the codecs worth to be tried for a block.
+// The best prediction is always selected, further ones only if their predictions are close.
+// @param in Block
+// @param len Block length in bytes
+// @param codecs Set of allowed codecs (bit mask of CodecBit)
+// @param candidates Maximum number of selected codecs
+// @param marginShift Further codecs are selected if their prediction is at most best + (best >> marginShift)
+// @return Set of selected codecs (bit mask of CodecBit)
+static UINT32 SelectCodecs(const UINT8* in, UINT32 len, UINT32 codecs, UINT32 candidates, UINT32 marginShift) {
+	BlockSignature sig;
+	UINT32 size[NofBlockCodecs];
+	UINT32 selected = 0, limit = NoSize;
+	int nCodecs;
+	const BlockCodec *codec = GetBlockCodecs(nCodecs);
+
+	ComputeSignature(in, len, sig);
+	sig.lz4Size = NoSize;
+	if (codecs & CodecBit(SC_LZ4)) {
+		// HC mode is a few percent smaller than the fast mode
+		char lz4buf[BufferSize/8];
+		ASSERT(len <= sizeof(lz4buf));
+		const int lz4len = LZ4_compress_default((const char *) in, lz4buf, len, len);
+		if (lz4len > 0) sig.lz4Size = lz4len - lz4len/32;
+	}
 
-		if (fselen > 2 && fselen < best) {
-			type = SC_FSE;
-			best = fselen;
+	for (int sc = 0; sc < NofBlockCodecs; sc++) size[sc] = NoSize;
+	for (int i = 0; i < nCodecs; i++) {
+		const int sc = codec[i].id;
+		size[sc] = (codecs & CodecBit(sc)) ? PredictSize(sig, codec[i].id) : NoSize;
+		if (size[sc] < NoSize) {
+			size[sc] = (size[sc] > codec[i].preference) ? size[sc] - codec[i].preference : 0;
 		}
-		if (fpclen < best) {
-			type = SC_FPC;
-			best = fpclen;
-		}
-		if (lz4len <= best) {
-			type = SC_LZ4;
-			best = lz4len;
-		}
-		if (rlebitsize < best + 16) {
-			type = SC_SRLE_BIT;
-			best = rlebitsize;
-		}
-		if (rlesize < best + 16) {
-			type = SC_SRLE;
-			best = rlesize;
+	}
+
+	for (UINT32 n = 0; n < candidates; n++) {
+		int bestSC = -1;
+		for (int sc = SC_FSE; sc < NofBlockCodecs; sc++) {
+			if (!(selected & CodecBit(sc)) && size[sc] < NoSize && (bestSC < 0 || size[sc] < size[bestSC])) bestSC = sc;
 		}
+		if (bestSC < 0 || size[bestSC] > limit) break;
+		if (!selected) limit = size[bestSC] + (size[bestSC] >> marginShift);
+		selected |= CodecBit(bestSC);
+	}
+	if (!selected) return codecs & CodecBit(SC_FSE);
 
-		count = 1;
-		UINT8 typebyte = type;
-		if (numpatches) typebyte |= SCFLAG_PATCHES;
-		m_stream->Write(&count, &typebyte);
+	return selected;
+}
 
-		if (type == SC_NONE) {
-			count = 2048;
-			m_stream->Write(&count, packedsign);
-		} else {
-			count = sizeof(UINT16);
-			best = __VAL((UINT16) best);
-			m_stream->Write(&count, &best);
-			count = __VAL((UINT16) best);
-
-			if (type == SC_FSE) {
-				m_stream->Write(&count, zopbuf + 16384);
-			} else if (type == SC_FPC) {
-				m_stream->Write(&count, zopbuf + 24 * 1024);
-			} else if (type == SC_SRLE) {
-				m_stream->Write(&count, rlebuf);
-			} else if (type == SC_SRLE_BIT) {
-				m_stream->Write(&count, rlebitbuf);
-			} else {
-				m_stream->Write(&count, zopbuf);
-			}
-		}
+/////////////////////////////////////////////////////////////////////
+// Write a 16 bit value in stream byte order into a code buffer.
+static inline UINT8* PutUINT16(UINT8* p, UINT16 val) {
+	val = __VAL(val);
+	memcpy(p, &val, sizeof(UINT16));
+	return p + sizeof(UINT16);
+}
 
-		if (numpatches) {
-			count = 1;
-			m_stream->Write(&count, &numpatches);
+/////////////////////////////////////////////////////////////////////
+// Write encoded macro block into stream.
+// The macro block has to be compressed with CMacroBlock::Compress before.
+// In the ROI encoding scheme the block record is preceded by its length and the ROI block header,
+// hence a decoder can skip irrelevant tiles without reading their block records:
+//		<blockLen>(16 bits) ROI Block
+//		ROI		::= <bufferSize>(15 bits) <tileEnd>(1 bit)
+// It might throw an IOException.
+void CEncoder::WriteMacroBlock(CMacroBlock* block) {
+	ASSERT(block);
+	ASSERT(block->m_codePos <= CodeBufferLen*WordBytes);
 
-			count = 2;
-			for (i = 0; i < numpatches; i++) {
-				m_stream->Write(&count, &patchaddr[i]);
-				m_stream->Write(&count, &patchval[i]);
-			}
-		}
-	} else {
-		SignCompression type = SC_NONE;
-		int count = 1;
-		m_stream->Write(&count, &type);
+#ifdef TRACE
+	//UINT32 filePos = (UINT32)m_stream->GetPos();
+	//printf("EncodeBuffer: %d\n", filePos);
+#endif
 
-		// Both buffers all zero, encode this as u16 zero
-		count = sizeof(UINT16);
-		UINT16 outsize = 0;
-		m_stream->Write(&count, &outsize);
+	int count;
+
+#ifdef __PGFROISUPPORT__
+	if (m_roi) {
+		// the block length prefix has 16 bits
+		if (block->m_codePos > USHRT_MAX) ReturnWithError(BlockTooLarge);
+		UINT16 prefix[2];
+		prefix[0] = __VAL(UINT16(block->m_codePos));
+		prefix[1] = __VAL(block->m_header.val);
+		count = sizeof(prefix);
+		m_stream->Write(&count, prefix);
 	}
+#endif
+
+	count = block->m_codePos;
+	m_stream->Write(&count, block->m_codeBuffer);
 
 	// store levelLength
 	if (m_levelLength) {
@@ -617,6 +860,210 @@ void CEncoder::WriteMacroBlock(CMacroBlock* block) {
 	// reset values
 	block->m_valuePos = 0;
 	block->m_maxAbsValue = 0;
+	block->m_codePos = 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Compress a byte plane with the given block codecs and keep the smallest result.
+// The cost model narrows the codecs according to the effort level. The codecs are tried
+// in the order of the codec table: a result is kept if it is smaller than the best result
+// so far plus the preference of its codec.
+// @param in Byte plane
+// @param len Length of the byte plane
+// @param codecs Set of allowed codecs (bit mask of CodecBit)
+// @param effort Effort level
+// @param planebuf Two buffers of PlaneBufferLen bytes
+// @param code [out] Kept result: one of the two buffers
+// @param best [in] Results of at least this size are discarded [out] Size of the kept result
+// @return Codec of the kept result or SC_NONE if no result has been kept
+static SignCompression TryCodecs(const UINT8* in, UINT32 len, UINT32 codecs, const EffortLevel& effort,
+								 UINT8 planebuf[2][PlaneBufferLen], UINT8*& code, UINT32& best) {
+	const BlockCodecParams params = { effort.lz4Level, effort.fseTableLog };
+	UINT8 *trial = planebuf[1];
+	SignCompression type = SC_NONE;
+	int nCodecs;
+	const BlockCodec *codec = GetBlockCodecs(nCodecs);
+
+	code = planebuf[0];
+	if (effort.candidates) {
+		codecs = SelectCodecs(in, len, codecs, effort.candidates, effort.marginShift);
+	}
+
+	for (int i = 0; i < nCodecs; i++) {
+		if (!(codecs & CodecBit(codec[i].id))) continue;
+		ASSERT(codec[i].compress && codec[i].bound(len) <= PlaneBufferLen);
+
+		const UINT32 size = codec[i].compress(in, len, trial, PlaneBufferLen, params);
+		if (size < NoSize && size < best + codec[i].preference) {
+			UINT8 *tmp = code;
+			code = trial;
+			trial = tmp;
+			type = codec[i].id;
+			best = size;
+		}
+	}
+	return type;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Compress a byte plane of BufferSize values with the smallest of the given block codecs.
+// An incompressible plane is stored uncompressed as SC_NONE.
+// Writes <type>(8 bits) <len>(16 bits) data and returns the new output position.
+static UINT8* CompressPlane(const UINT8* in, UINT32 codecs, const EffortLevel& effort, UINT8* out) {
+	UINT8 planebuf[2][PlaneBufferLen];
+	UINT8 *code;
+	UINT32 best = NoSize;
+	SignCompression type = TryCodecs(in, BufferSize, codecs, effort, planebuf, code, best);
+
+	if (best >= NoSize && (EnabledBlockCodecs(CodecPlaneAbs) & CodecBit(SC_FPC))) {
+		// all tried codecs failed, FPC handles every block
+		const BlockCodecParams params = { effort.lz4Level, effort.fseTableLog };
+		type = SC_FPC;
+		best = FindBlockCodec(SC_FPC, CodecPlaneAbs)->compress(in, BufferSize, code, PlaneBufferLen, params);
+	}
+	if (best > BufferSize) {
+		// incompressible plane: store it uncompressed
+		type = SC_NONE;
+		best = BufferSize;
+		code = (UINT8 *) in;
+	}
+
+	*out++ = (UINT8) type;
+	out = PutUINT16(out, (UINT16) best);
+	memcpy(out, code, best);
+	return out + best;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Split BufferSize values into low and high magnitude bytes and packed sign bits (LSB first).
+// Returns the bitwise or of all magnitudes and the number of magnitudes above 255.
+static void SplitValues(const DataT* value, UINT8* absbuf, UINT8* highbuf, UINT8* packedsign, UINT32& zerocheck, UINT32& numwide) {
+	UINT32 i = 0;
+	zerocheck = 0;
+	numwide = 0;
+
+#if defined(PGF_SIMD) && !defined(__PGF32SUPPORT__)
+	const SimdS16 zero = SimdSet(0);
+	SimdS16 orAbs = zero, narrow = zero;
+
+	for (; i < BufferSize; i += 2*SimdLanes) {
+		const SimdS16 v0 = SimdLoad(value + i), v1 = SimdLoad(value + i + SimdLanes);
+		const SimdS16 a0 = SimdAbs(v0), a1 = SimdAbs(v1);
+		const SimdS16 h0 = SimdHighBytes(a0), h1 = SimdHighBytes(a1);
+
+		SimdStoreLowBytes(absbuf + i, a0, a1);
+		SimdStoreLowBytes(highbuf + i, h0, h1);
+		const UINT32 signs = SimdSignMask(v0, v1);
+		packedsign[i/8] = (UINT8)signs;
+		packedsign[i/8 + 1] = (UINT8)(signs >> 8);
+
+		orAbs = SimdOr(orAbs, SimdOr(a0, a1));
+		// counts (negative) magnitudes up to 255 per lane
+		narrow = SimdAdd(narrow, SimdAdd(SimdCmpEq(h0, zero), SimdCmpEq(h1, zero)));
+	}
+	INT16 lanes[SimdLanes];
+	SimdStore(lanes, orAbs);
+	for (int k = 0; k < SimdLanes; k++) zerocheck |= (UINT16)lanes[k];
+	numwide = BufferSize + SimdSum(narrow);
+#else
+	memset(packedsign, 0, BufferSize/8);
+	for (; i < BufferSize; i++) {
+		const UINT32 a = abs(value[i]);
+		absbuf[i] = (UINT8) a;
+		highbuf[i] = (UINT8) (a >> 8);
+		packedsign[i / 8] |= (value[i] < 0 ? 1 : 0) << (i % 8);
+
+		zerocheck |= a;
+		numwide += a > 255;
+	}
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////
+// Compress this macro block into the internal code buffer.
+// The cost model selects the codecs per plane allowed by the effort level, the highest
+// levels try all allowed codecs. The smallest result is kept. The resulting block record
+// is stored in m_codeBuffer, its length in bytes in m_codePos.
+// Magnitudes above 255 are either patched or, if there are many of them, their high
+// bytes are coded in a separate wide plane with the same codec selection.
+// Several macro blocks can be compressed in parallel, all block codecs are reentrant.
+// Encoding scheme:
+//		Block	::= <absType>(8 bits) <absLen>(16 bits) absData [ Sign ]
+//		Sign	::= <signType>(8 bits) ( signBits(2048 bytes) | <signLen>(16 bits) signData ) [ Patches | Wide ]
+//		Patches	::= <numPatches>(8 bits) foreach(patch): <addr>(16 bits) <value>(16 bits)
+//		Wide	::= <highType>(8 bits) <highLen>(16 bits) highData
+// An all-zero block is encoded as SC_NONE with absLen 0 and no sign part,
+// an uncompressed magnitude plane as SC_NONE with absLen BufferSize.
+void CEncoder::CMacroBlock::Compress() {
+	UINT8 absbuf[16384], packedsign[2048], highbuf[16384], widebuf[16384 + 1024];
+	UINT32 i, zerocheck, numwide;
+	UINT8 *out = (UINT8 *) m_codeBuffer;
+	UINT8 *wideEnd = widebuf;
+
+	SplitValues(m_value, absbuf, highbuf, packedsign, zerocheck, numwide);
+
+	if (zerocheck) {
+		const EffortLevel& effort = EffortLevels[m_encoder->m_effort];
+		const UINT32 absCodecs = effort.absCodecs & EnabledBlockCodecs(CodecPlaneAbs);
+
+		// magnitudes above 255: few patches or a wide plane, whatever is smaller
+		bool wide = numwide > MaxPatches;
+		if (numwide > MinWideValues) {
+			wideEnd = CompressPlane(highbuf, absCodecs, effort, widebuf);
+			wide = wide || UINT32(wideEnd - widebuf) < 1 + 2*sizeof(UINT16)*numwide;
+		}
+		if (numwide && !wide) {
+			// patched values are coded as magnitude 1 to avoid the -256 "minus zero"
+			for (i = 0; i < 16384; i++) {
+				if (highbuf[i]) absbuf[i] = 1;
+			}
+		}
+
+		// magnitudes
+		out = CompressPlane(absbuf, absCodecs, effort, out);
+
+		// signs: an incompressible sign plane is stored uncompressed as SC_NONE without length
+		UINT8 planebuf[2][PlaneBufferLen];
+		UINT8 *code;
+		UINT32 best = 2028; // 2048 minus overhead heuristic
+		const SignCompression type = TryCodecs(packedsign, 2048, effort.signCodecs & EnabledBlockCodecs(CodecPlaneSign), effort, planebuf, code, best);
+
+		UINT8 typebyte = type;
+		if (wide) typebyte |= SCFLAG_WIDE;
+		else if (numwide) typebyte |= SCFLAG_PATCHES;
+		*out++ = typebyte;
+
+		if (type == SC_NONE) {
+			memcpy(out, packedsign, 2048);
+			out += 2048;
+		} else {
+			out = PutUINT16(out, (UINT16) best);
+			memcpy(out, code, best);
+			out += best;
+		}
+
+		if (wide) {
+			// high bytes of all magnitudes
+			memcpy(out, widebuf, wideEnd - widebuf);
+			out += wideEnd - widebuf;
+		} else if (numwide) {
+			*out++ = (UINT8) numwide;
+
+			for (i = 0; i < 16384; i++) {
+				if (highbuf[i]) {
+					out = PutUINT16(out, (UINT16) i);
+					out = PutUINT16(out, (UINT16) m_value[i]);
+				}
+			}
+		}
+	} else {
+		// Both buffers all zero, encode this as u16 zero
+		*out++ = SC_NONE;
+		out = PutUINT16(out, 0);
+	}
+
+	m_codePos = UINT32(out - (UINT8 *) m_codeBuffer);
+	ASSERT(m_codePos <= CodeBufferLen*WordBytes);
 }
 
 ////////////////////////////////////////////////////////
@@ -81,12 +81,21 @@ class CEncoder {
 		/// Call CEncoder::WriteMacroBlock after this method.
 		void BitplaneEncode();
 
+		//////////////////////////////////////////////////////////////////////
+		/// Compresses this macro block into internal code buffer.
+		/// Selects the smallest block codec for the magnitude and sign planes among the
+		/// candidates predicted by the cost model. The effort level of the encoder defines
+		/// the allowed codecs and the number of candidates.
+		/// Several macro blocks can be compressed in parallel.
+		/// Call CEncoder::WriteMacroBlock after this method.
+		void Compress();
+
 		DataT	m_value[BufferSize];				///< input buffer of values with index m_valuePos
 		UINT32	m_codeBuffer[CodeBufferLen];		///< output buffer for encoded bitstream
 		ROIBlockHeader m_header;					///< block header
 		UINT32	m_valuePos;							///< current buffer position
 		UINT32	m_maxAbsValue;						///< maximum absolute coefficient in each buffer
-		UINT32	m_codePos;							///< current position in encoded bitstream
+		UINT32	m_codePos;							///< current position in encoded bitstream (in bytes after Compress)
 		int		m_lastLevelIndex;					///< index of last encoded level: [0, nLevels); used because a level-end can occur before a buffer is full
 
 	private:
@@ -112,13 +121,29 @@ public:
 	CEncoder(CPGFStream* stream, PGFPreHeader preHeader, PGFHeader header, const PGFPostHeader& postHeader,
 		UINT64& userDataPos, bool useOMP); // throws IOException
 
+	/////////////////////////////////////////////////////////////////////
+	/// Constructor of an encoder writing the levels of an image whose headers are already in the stream.
+	/// The stream position has to be at the beginning of the level lengths (see WriteLevelLength).
+	/// It might throw an IOException.
+	/// @param stream A PGF stream
+	/// @param header The already written PGF header
+	/// @param useOMP If true, then the encoder will use multi-threading based on openMP
+	CEncoder(CPGFStream* stream, const PGFHeader& header, bool useOMP); // throws IOException
+
 	/////////////////////////////////////////////////////////////////////
 	/// Destructor
 	~CEncoder();
 
 	/////////////////////////////////////////////////////////////////////
-	/// Encoder favors speed over compression size
-	void FavorSpeedOverSize() { m_favorSpeed = true; }
+	/// Encoder favors speed over compression size.
+	/// The effort level is limited to FastEncoderEffort.
+	void FavorSpeedOverSize() { m_favorSpeed = true; if (m_effort > FastEncoderEffort) m_effort = FastEncoderEffort; }
+
+	/////////////////////////////////////////////////////////////////////
+	/// Set encoder effort level.
+	/// Higher levels try more block codecs and use stronger codec settings.
+	/// @param effort Effort level [0, MaxEncoderEffort]
+	void SetEffort(UINT8 effort) { ASSERT(effort <= MaxEncoderEffort); m_effort = __min(effort, MaxEncoderEffort); }
 
 	/////////////////////////////////////////////////////////////////////
 	/// Pad buffer with zeros and encode buffer.
@@ -168,6 +193,16 @@ public:
 	/// @param bandPos A valid position in subband band
 	void WriteValue(CSubband* band, int bandPos);
 
+	/////////////////////////////////////////////////////////////////////
+	/// Compresses the values of a decoded block record again and writes the block into stream.
+	/// The wavelet coefficients are not changed: only the block codecs are selected anew,
+	/// according to the effort level of this encoder.
+	/// It might throw an IOException.
+	/// @param value BufferSize values of the decoded block record
+	/// @param h ROI block header of the decoded block record
+	/// @param lastLevelIndex Level length directory index of the last level completed by this block: [-1, nLevels)
+	void RecodeBlock(const DataT* value, ROIBlockHeader h, int lastLevelIndex);
+
 	/////////////////////////////////////////////////////////////////////
 	/// Compute stream length of header.
 	/// @return header length
@@ -207,6 +242,7 @@ public:
 #endif
 
 private:
+	void InitMacroBlocks(bool useOMP); // throws IOException
 	void EncodeBuffer(ROIBlockHeader h); // throws IOException
 	void WriteMacroBlock(CMacroBlock* block); // throws IOException
 
@@ -224,6 +260,7 @@ private:
 	int     m_currLevelIndex;					///< counts where (=index) to save next value
 	UINT8	m_nLevels;							///< number of levels
 	bool	m_favorSpeed;						///< favor speed over size
+	UINT8	m_effort;							///< effort level [0, MaxEncoderEffort]
 	bool	m_forceWriting;						///< all macro blocks have to be written into the stream
 #ifdef __PGFROISUPPORT__
 	bool	m_roi;								///< true: ensures region of interest (ROI) encoding
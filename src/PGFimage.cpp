@@ -29,7 +29,9 @@
 #include "PGFimage.h"
 #include "Decoder.h"
 #include "Encoder.h"
+#include "BlockCodec.h"
 #include "BitStream.h"
+#include "SIMD.h"
 #include <cmath>
 #include <cstring>
 
@@ -37,8 +39,14 @@
 #define YUVoffset6		32				// 2^5
 #define YUVoffset8		128				// 2^7
 #define YUVoffset16		32768			// 2^15
+#define ImportStripRows	16				// number of rows converted at once in ImportRows
+#define BitmapBandRows	64				// number of rows converted by one thread in GetBitmap
 //#define YUVoffset31		1073741824		// 2^30
 
+#if defined(PGF_SIMD) && !defined(__PGF32SUPPORT__)
+#define PGF_SIMD_COLOR					// vectorized YUV to RGB kernels in GetBitmap
+#endif
+
 //////////////////////////////////////////////////////////////////////
 // global methods and variables
 #ifdef NEXCEPTIONS
@@ -78,6 +86,7 @@ void CPGFImage::Init() {
 #endif
 	m_currentLevel = 0;
 	m_quant = 0;
+	m_encoderEffort = DefaultEncoderEffort;
 	m_userDataPos = 0;
 	m_downsample = false;
 	m_favorSpeedOverSize = false;
@@ -88,6 +97,10 @@ void CPGFImage::Init() {
 	m_progressMode = PM_Relative;
 	m_percent = 0;
 	m_userDataPolicy = UP_CacheAll;
+	m_importedRows = 0;
+	m_importPending = 0;
+	m_importBpp = 0;
+	m_importing = false;
 
 	// init preHeader
 	memcpy(m_preHeader.magic, PGFMagic, 3);
@@ -103,6 +116,7 @@ void CPGFImage::Init() {
 	for (int i = 0; i < MaxChannels; i++) {
 		m_channel[i] = nullptr;
 		m_wtChannel[i] = nullptr;
+		m_importRows[i] = nullptr;
 	}
 
 	// set image width and height
@@ -124,6 +138,7 @@ CPGFImage::~CPGFImage() {
 void CPGFImage::Destroy() {
 	for (int i = 0; i < m_header.channels; i++) {
 		delete m_wtChannel[i]; // also deletes m_channel
+		delete[] m_importRows[i];
 	}
 	delete[] m_postHeader.userData;
 	delete[] m_levelLength;
@@ -517,30 +532,38 @@ void CPGFImage::Read(PGFRect& rect, int level /*= 0*/, CallbackPtr cb /*= nullpt
 		SetROI(rect);
 
 		while (m_currentLevel > level) {
-			for (int i=0; i < m_header.channels; i++) {
-				CWaveletTransform* wtChannel = m_wtChannel[i];
-				ASSERT(wtChannel);
-
-				// get number of tiles and tile indices
-				const UINT32 nTiles = wtChannel->GetNofTiles(m_currentLevel); // independent of ROI
-
-				// decode file and write stream to m_wtChannel
-				if (m_currentLevel == m_header.nLevels) { // last level also has LL band
-					ASSERT(nTiles == 1);
-					m_decoder->GetNextMacroBlock();
-					wtChannel->GetSubband(m_currentLevel, LL)->PlaceTile(*m_decoder, m_quant);
-				}
-				for (UINT32 tileY=0; tileY < nTiles; tileY++) {
-					for (UINT32 tileX=0; tileX < nTiles; tileX++) {
-						// check relevance of tile
-						if (wtChannel->TileIsRelevant(m_currentLevel, tileX, tileY)) {
-							m_decoder->GetNextMacroBlock();
-							wtChannel->GetSubband(m_currentLevel, HL)->PlaceTile(*m_decoder, m_quant, true, tileX, tileY);
-							wtChannel->GetSubband(m_currentLevel, LH)->PlaceTile(*m_decoder, m_quant, true, tileX, tileY);
-							wtChannel->GetSubband(m_currentLevel, HH)->PlaceTile(*m_decoder, m_quant, true, tileX, tileY);
-						} else {
-							// skip tile
-							m_decoder->SkipTileBuffer();
+#ifdef LIBPGF_USE_OPENMP
+			if (m_useOMPinDecoder) {
+				// decode relevant tiles of all channels concurrently
+				ReadTiles();
+			} else
+#endif
+			{
+				for (int i=0; i < m_header.channels; i++) {
+					CWaveletTransform* wtChannel = m_wtChannel[i];
+					ASSERT(wtChannel);
+
+					// get number of tiles and tile indices
+					const UINT32 nTiles = wtChannel->GetNofTiles(m_currentLevel); // independent of ROI
+
+					// decode file and write stream to m_wtChannel
+					if (m_currentLevel == m_header.nLevels) { // last level also has LL band
+						ASSERT(nTiles == 1);
+						m_decoder->GetNextMacroBlock();
+						wtChannel->GetSubband(m_currentLevel, LL)->PlaceTile(*m_decoder, m_quant);
+					}
+					for (UINT32 tileY=0; tileY < nTiles; tileY++) {
+						for (UINT32 tileX=0; tileX < nTiles; tileX++) {
+							// check relevance of tile
+							if (wtChannel->TileIsRelevant(m_currentLevel, tileX, tileY)) {
+								m_decoder->GetNextMacroBlock();
+								wtChannel->GetSubband(m_currentLevel, HL)->PlaceTile(*m_decoder, m_quant, true, tileX, tileY);
+								wtChannel->GetSubband(m_currentLevel, LH)->PlaceTile(*m_decoder, m_quant, true, tileX, tileY);
+								wtChannel->GetSubband(m_currentLevel, HH)->PlaceTile(*m_decoder, m_quant, true, tileX, tileY);
+							} else {
+								// skip tile
+								m_decoder->SkipTileBuffer();
+							}
 						}
 					}
 				}
@@ -576,7 +599,110 @@ void CPGFImage::Read(PGFRect& rect, int level /*= 0*/, CallbackPtr cb /*= nullpt
 	}
 }
 
+///////////////////////////////////////////////////////////////////////
+// A relevant tile of the current level and its tile decoder (see ReadTiles).
+struct TileJob {
+	CDecoder *decoder;	// tile decoder
+	int channel;		// channel index
+	UINT32 tileX;		// x-index of the tile
+	UINT32 tileY;		// y-index of the tile
+	bool ll;			// LL band of the last level instead of a tile of HL, LH, and HH
+};
+
 //////////////////////////////////////////////////////////////////////
+// Read and decode the relevant tiles of all channels at the current level.
+// The tiles are read sequentially, irrelevant tiles are skipped. Then the relevant tiles are
+// decoded and placed into their subbands concurrently, each tile by its own tile decoder.
+// Used with ROI encoding scheme only.
+// It might throw an IOException.
+void CPGFImage::ReadTiles() {
+	ASSERT(m_decoder);
+	ASSERT(ROIisSupported());
+
+	// upper bound of relevant tiles: the last level also has a LL band per channel
+	int maxJobs = 0;
+	for (int i=0; i < m_header.channels; i++) {
+		const UINT32 nTiles = m_wtChannel[i]->GetNofTiles(m_currentLevel);
+		maxJobs += nTiles*nTiles + 1;
+	}
+	TileJob *jobs = new(std::nothrow) TileJob[maxJobs];
+	if (!jobs) ReturnWithError(InsufficientMemory);
+	int nJobs = 0;
+	volatile OSError error = NoError; // volatile prevents optimizations
+
+	// read relevant tiles and allocate their subbands
+	try {
+		for (int i=0; i < m_header.channels && error == NoError; i++) {
+			CWaveletTransform* wtChannel = m_wtChannel[i];
+			ASSERT(wtChannel);
+
+			// get number of tiles and tile indices
+			const UINT32 nTiles = wtChannel->GetNofTiles(m_currentLevel); // independent of ROI
+
+			if (m_currentLevel == m_header.nLevels) { // last level also has LL band
+				ASSERT(nTiles == 1);
+				if (!wtChannel->GetSubband(m_currentLevel, LL)->AllocMemory()) error = InsufficientMemory;
+				jobs[nJobs].decoder = m_decoder->ReadTile();
+				jobs[nJobs].channel = i;
+				jobs[nJobs].tileX = jobs[nJobs].tileY = 0;
+				jobs[nJobs].ll = true;
+				nJobs++;
+			}
+			if (!wtChannel->GetSubband(m_currentLevel, HL)->AllocMemory() ||
+				!wtChannel->GetSubband(m_currentLevel, LH)->AllocMemory() ||
+				!wtChannel->GetSubband(m_currentLevel, HH)->AllocMemory()) error = InsufficientMemory;
+
+			for (UINT32 tileY=0; tileY < nTiles; tileY++) {
+				for (UINT32 tileX=0; tileX < nTiles; tileX++) {
+					// check relevance of tile
+					if (wtChannel->TileIsRelevant(m_currentLevel, tileX, tileY)) {
+						jobs[nJobs].decoder = m_decoder->ReadTile();
+						jobs[nJobs].channel = i;
+						jobs[nJobs].tileX = tileX;
+						jobs[nJobs].tileY = tileY;
+						jobs[nJobs].ll = false;
+						nJobs++;
+					} else {
+						// skip tile
+						m_decoder->SkipTileBuffer();
+					}
+				}
+			}
+		}
+	} catch (IOException& ex) {
+		error = ex.error;
+	}
+
+	// decode relevant tiles
+#ifdef LIBPGF_USE_OPENMP
+	#pragma omp parallel for default(shared) schedule(dynamic)
+#endif
+	for (int t=0; t < nJobs; t++) {
+		if (error == NoError) {
+			const TileJob& job = jobs[t];
+			CWaveletTransform* wtChannel = m_wtChannel[job.channel];
+
+			try {
+				job.decoder->GetNextMacroBlock();
+				if (job.ll) {
+					wtChannel->GetSubband(m_currentLevel, LL)->PlaceTile(*job.decoder, m_quant);
+				} else {
+					wtChannel->GetSubband(m_currentLevel, HL)->PlaceTile(*job.decoder, m_quant, true, job.tileX, job.tileY);
+					wtChannel->GetSubband(m_currentLevel, LH)->PlaceTile(*job.decoder, m_quant, true, job.tileX, job.tileY);
+					wtChannel->GetSubband(m_currentLevel, HH)->PlaceTile(*job.decoder, m_quant, true, job.tileX, job.tileY);
+				}
+			} catch (IOException& ex) {
+				error = ex.error;
+			}
+		}
+	}
+
+	for (int t=0; t < nJobs; t++) delete jobs[t].decoder;
+	delete[] jobs;
+	if (error != NoError) ReturnWithError(error);
+}
+
+/////////////////////////////////////////////////////////////////////
 /// Return ROI of channel 0 at current level in pixels.
 /// The returned rect is only valid after reading a ROI.
 /// @return ROI in pixels
@@ -650,6 +776,16 @@ UINT32 CPGFImage::GetEncodedHeaderLength() const {
 	return m_decoder->GetEncodedHeaderLength();
 }
 
+//////////////////////////////////////////////////////////////////////
+/// Return a rough estimation of the encoded image size in bytes.
+/// Precondition: The PGF header has been set with SetHeader(...) or read with Open(...).
+/// @return Estimated length of the encoded PGF image in bytes
+UINT64 CPGFImage::GetEncodedSizeEstimate() const {
+	const UINT64 imageSize = ((UINT64)m_header.width*m_header.height*m_header.bpp + 7)/8;
+
+	return PreHeaderSize + m_preHeader.hSize + m_header.nLevels*WordBytes + (imageSize >> m_header.quality);
+}
+
 //////////////////////////////////////////////////////////////////////
 /// Reads the encoded PGF header and copies it to a target buffer.
 /// Precondition: The PGF image has been opened with a call of Open(...).
@@ -730,6 +866,178 @@ UINT32 CPGFImage::ReadEncodedData(int level, UINT8* target, UINT32 targetLen) co
 	return len;
 }
 
+//////////////////////////////////////////////////////////////////////
+// Copies encoded data at the current stream position of the decoder into a given stream.
+// It might throw an IOException.
+static void CopyEncodedData(CDecoder* decoder, CPGFStream* stream, UINT64 len) {
+	UINT8 buff[BufferSize];
+
+	while (len > 0) {
+		int count = (int)__min(len, (UINT64)BufferSize);
+		if (decoder->ReadEncodedData(buff, count) != (UINT32)count) ReturnWithError(MissingData);
+		stream->Write(&count, buff);
+		len -= count;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+/// Writes a reduced resolution PGF image containing the levels >= level of this image into a stream.
+/// The encoded levels are copied without decoding, only the header and the level lengths are rewritten.
+/// Precondition: The PGF image has been opened with a call of Open(...).
+/// It might throw an IOException.
+/// @param stream A PGF stream
+/// @param level The image level of the written image
+/// @return The number of bytes written into stream
+UINT32 CPGFImage::WriteTruncated(CPGFStream* stream, int level) const {
+	ASSERT(stream);
+	ASSERT(level >= 0 && level < m_header.nLevels);
+	ASSERT(m_decoder);
+	if (!m_levelLength) ReturnWithError2(FormatCannotRead, 0);
+
+	const int nLevels = m_header.nLevels - level;
+
+	// the subband levels decrease by level: lower the quantization parameter accordingly (see CSubband::PlaceTile)
+	const UINT8 quant = (UINT8)__max(m_quant - level, 0);
+	const UINT8 quality = quant + (m_downsample ? 1 : 0);
+	if (m_downsample && quality <= DownsampleThreshold) ReturnWithError2(CannotTruncate, 0);
+
+	const UINT64 startPos = stream->GetPos();
+	const UINT64 readPos = m_decoder->GetStream()->GetPos();
+	int count;
+
+	// pre-header
+	PGFPreHeader preHeader;
+	const UINT32 preHeaderLen = MagicVersionSize + ((m_preHeader.version & Version6) ? 4 : 2);
+	m_decoder->SetStreamPosToStart();
+	if (m_decoder->ReadEncodedData((UINT8*)&preHeader, preHeaderLen) != preHeaderLen) ReturnWithError2(MissingData, 0);
+	count = preHeaderLen;
+	stream->Write(&count, &preHeader);
+
+	// header: size, levels, and quality of the written image
+	PGFHeader header;
+	const UINT32 headerLen = __min(m_preHeader.hSize, (UINT32)HeaderSize);
+	if (m_decoder->ReadEncodedData((UINT8*)&header, headerLen) != headerLen) ReturnWithError2(MissingData, 0);
+	header.width = __VAL(Width(level));
+	header.height = __VAL(Height(level));
+	header.nLevels = (UINT8)nLevels;
+	header.quality = quality;
+	count = headerLen;
+	stream->Write(&count, &header);
+
+	// post-header
+	CopyEncodedData(m_decoder, stream, m_preHeader.hSize - headerLen);
+
+	// level lengths
+	UINT64 dataLen = 0;
+	for (int i=0; i < nLevels; i++) {
+		UINT32 len = __VAL(m_levelLength[i]);
+		count = WordBytes;
+		stream->Write(&count, &len);
+		dataLen += m_levelLength[i];
+	}
+
+	// encoded levels
+	m_decoder->SetStreamPosToData();
+	CopyEncodedData(m_decoder, stream, dataLen);
+
+	// a following Read continues at the previous stream position
+	m_decoder->GetStream()->SetPos(FSFromStart, readPos);
+
+	return (UINT32)(stream->GetPos() - startPos);
+}
+
+//////////////////////////////////////////////////////////////////////
+/// Writes this image with block codecs selected anew at a given effort level into a stream.
+/// The block records are decompressed and compressed again, the wavelet coefficients aren't changed.
+/// Headers and user data are copied, the level lengths are rewritten.
+/// The uncoded channel data of very small images without wavelet levels is copied unchanged.
+/// Precondition: The PGF image has been opened with a call of Open(...).
+/// It might throw an IOException.
+/// @param stream A PGF stream
+/// @param effort Encoder effort level [0, MaxEncoderEffort]
+/// @return The number of bytes written into stream
+UINT32 CPGFImage::Recompress(CPGFStream* stream, UINT8 effort /*= MaxEncoderEffort*/) const {
+	ASSERT(stream);
+	ASSERT(effort <= MaxEncoderEffort);
+	ASSERT(m_decoder);
+	if (!m_levelLength) ReturnWithError2(FormatCannotRead, 0);
+
+	const int nLevels = m_header.nLevels;
+	const UINT64 startPos = stream->GetPos();
+	CPGFStream *source = m_decoder->GetStream();
+	const UINT64 readPos = source->GetPos();
+
+	if (nLevels == 0) {
+		// very small image: the channel data follows the headers uncoded and is copied as it is (see Open)
+		UINT64 dataLen = 0;
+		for (int c=0; c < m_header.channels; c++) {
+			dataLen += UINT64(m_width[c])*m_height[c]*DataTSize;
+		}
+		m_decoder->SetStreamPosToStart();
+		CopyEncodedData(m_decoder, stream, m_decoder->GetEncodedHeaderLength() + dataLen);
+
+		// a following Read continues at the previous stream position
+		source->SetPos(FSFromStart, readPos);
+		return (UINT32)(stream->GetPos() - startPos);
+	}
+
+	// pre-header, header, and post-header
+	m_decoder->SetStreamPosToStart();
+	CopyEncodedData(m_decoder, stream, m_decoder->GetEncodedHeaderLength() - nLevels*WordBytes);
+
+	// the block records are read by a decoder of their own: the state of m_decoder isn't changed
+	PGFPreHeader preHeader;
+	PGFHeader header;
+	PGFPostHeader postHeader;
+	UINT32 *levelLength = nullptr, *newLevelLength = nullptr;
+	UINT64 userDataPos;
+
+	try {
+		m_decoder->SetStreamPosToStart();
+		CDecoder decoder(source, preHeader, header, postHeader, levelLength, userDataPos, false, 0xFFFFFFFF - UP_Skip);
+		CEncoder encoder(stream, header, m_useOMPinEncoder);
+		encoder.SetEffort(effort);
+	#ifdef __PGFROISUPPORT__
+		if (preHeader.version & PGFROI) encoder.SetROI();
+	#endif
+		encoder.WriteLevelLength(newLevelLength);
+
+		// recode all block records: a block belongs to the level it starts in, levels consist of whole blocks
+		decoder.SetStreamPosToData();
+		const UINT64 dataPos = source->GetPos();
+		UINT64 levelEnd = 0, blockEnd = 0;
+		int lastLevelIndex = -1;
+
+		while (lastLevelIndex < nLevels - 1) {
+			ROIBlockHeader h(0);
+			const DataT *value = decoder.DecodeBlock(h);
+			const UINT64 blockStart = blockEnd;
+			blockEnd = source->GetPos() - dataPos;
+
+			while (lastLevelIndex < nLevels - 1 && blockEnd >= levelEnd + levelLength[lastLevelIndex + 1]) {
+				levelEnd += levelLength[++lastLevelIndex];
+			}
+			if (blockStart < levelEnd && levelEnd < blockEnd) ReturnWithError2(FormatCannotRead, 0);
+			encoder.RecodeBlock(value, h, lastLevelIndex);
+		}
+
+		// level lengths
+		encoder.UpdateLevelLength();
+	} catch (IOException&) {
+		delete[] levelLength;
+		delete[] newLevelLength;
+		source->SetPos(FSFromStart, readPos);
+		throw;
+	}
+	delete[] levelLength;
+	delete[] newLevelLength;
+
+	// a following Read continues at the previous stream position
+	source->SetPos(FSFromStart, readPos);
+
+	return (UINT32)(stream->GetPos() - startPos);
+}
+
 //////////////////////////////////////////////////////////////////////
 /// Set maximum intensity value for image modes with more than eight bits per channel.
 /// Call this method after SetHeader, but before ImportBitmap.
@@ -762,6 +1070,16 @@ BYTE CPGFImage::UsedBitsPerChannel() const {
 	}
 }
 
+//////////////////////////////////////////////////////////////////////
+/// Enables or disables a block codec for all encoders of this process.
+/// Must not be called while images are encoded.
+/// @param codec A block codec
+/// @param enable True: the encoder tries this codec; false: the codec is not used
+/// @return False if the codec is unknown
+bool CPGFImage::EnableBlockCodec(SignCompression codec, bool enable) {
+	return ::EnableBlockCodec(codec, enable);
+}
+
 //////////////////////////////////////////////////////////////////////
 /// Return major version
 BYTE CPGFImage::CodecMajorVersion(BYTE version) {
@@ -793,7 +1111,7 @@ void CPGFImage::ImportBitmap(int pitch, UINT8 *buff, BYTE bpp, int channelMap[]
 	ASSERT(m_channel[0]);
 
 	// color transform
-	RgbToYuv(pitch, buff, bpp, channelMap, cb, data);
+	RgbToYuv(pitch, buff, bpp, channelMap, cb, data, m_channel, m_header.height);
 
 	if (m_downsample) {
 		// Subsampling of the chrominance and alpha channels
@@ -808,16 +1126,32 @@ void CPGFImage::ImportBitmap(int pitch, UINT8 *buff, BYTE bpp, int channelMap[]
 // Called before Write()
 void CPGFImage::Downsample(int ch) {
 	ASSERT(ch > 0);
+	ASSERT(m_channel[ch]);
+
+	DownsampleRows(m_channel[ch], m_height[0], true);
+
+	// downsampled image has half width and half height
+	m_width[ch] = (m_width[ch] + 1)/2;
+	m_height[ch] = (m_height[ch] + 1)/2;
+}
+
+/////////////////////////////////////////////////////////////////
+// Bilinerar Subsampling of nRows consecutive rows of full width by a factor 2.
+// The downsampled rows are stored in place at the beginning of buff.
+// An odd last row is only downsampled horizontally if it is the last row of the image (lastRows),
+// otherwise it is left untouched.
+// @return The number of downsampled rows
+UINT32 CPGFImage::DownsampleRows(DataT* buff, UINT32 nRows, bool lastRows) const {
+	ASSERT(buff);
 
 	const int w = m_width[0];
 	const int w2 = w/2;
-	const int h2 = m_height[0]/2;
+	const int h2 = nRows/2;
 	const int oddW = w%2;				// don't use bool -> problems with MaxSpeed optimization
-	const int oddH = m_height[0]%2;		// "
+	const int oddH = nRows%2;			// "
 	int loPos = 0;
 	int hiPos = w;
 	int sampledPos = 0;
-	DataT* buff = m_channel[ch]; ASSERT(buff);
 
 	for (int i=0; i < h2; i++) {
 		for (int j=0; j < w2; j++) {
@@ -833,7 +1167,7 @@ void CPGFImage::Downsample(int ch) {
 		}
 		loPos += w; hiPos += w;
 	}
-	if (oddH) {
+	if (oddH && lastRows) {
 		for (int j=0; j < w2; j++) {
 			buff[sampledPos] = (buff[loPos] + buff[loPos+1]) >> 1;
 			loPos += 2; hiPos += 2;
@@ -842,11 +1176,148 @@ void CPGFImage::Downsample(int ch) {
 		if (oddW) {
 			buff[sampledPos] = buff[loPos];
 		}
+		return h2 + 1;
 	}
+	return h2;
+}
 
-	// downsampled image has half width and half height
-	m_width[ch] = (m_width[ch] + 1)/2;
-	m_height[ch] = (m_height[ch] + 1)/2;
+//////////////////////////////////////////////////////////////////
+// Start a streaming import of an image. Call this method after SetHeader(...) instead of ImportBitmap(...),
+// then pass the image rows in top-down order with ImportRows(...), and finish with EndImport().
+// Only a few rows per channel are kept: the rows are converted to YUV as they arrive and immediately
+// passed to a strip-based forward wavelet transform, hence the channels at full size are never allocated.
+// The encoded image is identical to an image imported with ImportBitmap(...).
+// It might throw an IOException.
+// @param bpp The number of bits per pixel used in the image rows.
+// @param channelMap A integer array containing the mapping of input channel ordering to expected channel ordering.
+void CPGFImage::BeginImport(BYTE bpp, int channelMap[] /*= nullptr*/) {
+	ASSERT(!m_importing);
+	ASSERT(m_channel[0]);
+
+	m_importBpp = bpp;
+	for (int i=0; i < MaxChannels; i++) {
+		m_importMap[i] = (channelMap && i < m_header.channels) ? channelMap[i] : i;
+	}
+	m_importedRows = 0;
+	m_importPending = 0;
+	m_importing = true;
+
+	if (m_header.nLevels > 0) {
+		for (int i=0; i < m_header.channels; i++) {
+			// the strip-based transform doesn't need the channel allocated in SetHeader
+			ASSERT(!m_wtChannel[i]);
+			delete[] m_channel[i]; m_channel[i] = nullptr;
+			if (m_downsample && i > 0) {
+				// downsampled channel has half width and half height
+				m_width[i] = (m_width[i] + 1)/2;
+				m_height[i] = (m_height[i] + 1)/2;
+			}
+
+			m_importRows[i] = new(std::nothrow) DataT[(ImportStripRows + 1)*m_header.width];
+			if (!m_importRows[i]) ReturnWithError(InsufficientMemory);
+			m_wtChannel[i] = new(std::nothrow) CWaveletTransform(m_width[i], m_height[i], m_header.nLevels);
+			if (!m_wtChannel[i]) ReturnWithError(InsufficientMemory);
+		#ifdef __PGFROISUPPORT__
+			m_wtChannel[i]->SetROI(PGFRect(0, 0, m_width[i], m_height[i]));
+		#endif
+			OSError err = m_wtChannel[i]->BeginForwardStrip(m_quant);
+			if (err != NoError) ReturnWithError(err);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+// Import the next rows of a streaming import (see BeginImport).
+// The absolute value of pitch is the number of bytes of an image row.
+// If pitch is negative, then buff points to the last row of the given rows in a bottom-up buffer (first byte on last row).
+// If pitch is positive, then buff points to the first row of the given rows in a top-down buffer (first byte).
+// It might throw an IOException.
+// @param pitch The number of bytes of a row of the image buffer.
+// @param buff An image buffer containing nRows rows.
+// @param nRows The number of rows
+void CPGFImage::ImportRows(int pitch, UINT8 *buff, UINT32 nRows) {
+	ASSERT(m_importing);
+	ASSERT(buff);
+	ASSERT(m_importedRows + nRows <= m_header.height);
+	DataT* rows[MaxChannels];
+
+	if (m_header.nLevels == 0) {
+		// very small image: no wavelet transform, store rows in channels
+		for (int i=0; i < m_header.channels; i++) {
+			rows[i] = m_channel[i] + m_importedRows*m_header.width;
+		}
+		RgbToYuv(pitch, buff, m_importBpp, m_importMap, nullptr, nullptr, rows, nRows);
+		m_importedRows += nRows;
+		return;
+	}
+
+	while (nRows > 0) {
+		const UINT32 n = __min(nRows, ImportStripRows);
+
+		// color transform: an odd row of downsampled channels is still buffered
+		for (int i=0; i < m_header.channels; i++) {
+			rows[i] = m_importRows[i];
+			if (m_downsample && i > 0) rows[i] += m_importPending*m_header.width;
+		}
+		RgbToYuv(pitch, buff, m_importBpp, m_importMap, nullptr, nullptr, rows, n);
+		m_importedRows += n;
+
+		ImportStrip(n);
+
+		buff += pitch*(int)n;
+		nRows -= n;
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+// Downsample and transform the rows converted in ImportRows.
+// @param nRows The number of converted rows
+void CPGFImage::ImportStrip(UINT32 nRows) {
+	const bool lastRows = m_importedRows == m_header.height;
+	const UINT32 nBuffered = m_importPending + nRows;
+
+	// wavelet subband decomposition
+#ifdef LIBPGF_USE_OPENMP
+	#pragma omp parallel for default(shared)
+#endif
+	for (int i=0; i < m_header.channels; i++) {
+		DataT* rows = m_importRows[i];
+
+		if (m_downsample && i > 0) {
+			const UINT32 n = DownsampleRows(rows, nBuffered, lastRows);
+			if (n) m_wtChannel[i]->ForwardStrip(rows, n);
+			if (nBuffered > 2*n) {
+				// keep odd row for the next call
+				ASSERT(nBuffered == 2*n + 1);
+				if (n) memcpy(rows, rows + 2*n*m_header.width, m_header.width*DataTSize);
+			}
+		} else {
+			m_wtChannel[i]->ForwardStrip(rows, nRows);
+		}
+	}
+
+	if (m_downsample && !lastRows) m_importPending = nBuffered%2;
+}
+
+//////////////////////////////////////////////////////////////////
+// Finish a streaming import (see BeginImport) and release its row buffers.
+// It throws an IOException with MissingData, if not all rows of the image have been imported.
+void CPGFImage::EndImport() {
+	ASSERT(m_importing);
+
+	for (int i=0; i < m_header.channels; i++) {
+		delete[] m_importRows[i]; m_importRows[i] = nullptr;
+	}
+	m_importing = false;
+
+	if (m_importedRows != m_header.height) ReturnWithError(MissingData);
+
+	if (m_header.nLevels == 0 && m_downsample) {
+		// Subsampling of the chrominance and alpha channels
+		for (int i=1; i < m_header.channels; i++) {
+			Downsample(i);
+		}
+	}
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -976,6 +1447,7 @@ void CPGFImage::SetHeader(const PGFHeader& header, BYTE flags /*=0*/, const UINT
 /// @param stream A PGF stream
 /// @return The number of bytes written into stream.
 UINT32 CPGFImage::WriteHeader(CPGFStream* stream) {
+	ASSERT(!m_importing);
 	ASSERT(m_header.nLevels <= MaxLevel);
 	ASSERT(m_header.quality <= MaxQuality); // quality is already initialized
 
@@ -987,6 +1459,11 @@ UINT32 CPGFImage::WriteHeader(CPGFStream* stream) {
 #endif
 		for (int i=0; i < m_header.channels; i++) {
 			DataT *temp = nullptr;
+			if (!m_channel[i]) {
+				// channel has already been transformed in a streaming import (see BeginImport)
+				ASSERT(m_wtChannel[i]);
+				continue;
+			}
 			if (error == NoError) {
 				if (m_wtChannel[i]) {
 					ASSERT(m_channel[i]);
@@ -1036,6 +1513,7 @@ UINT32 CPGFImage::WriteHeader(CPGFStream* stream) {
 
 		// create encoder, write headers and user data, but not level-length area
 		m_encoder = new CEncoder(stream, m_preHeader, m_header, m_postHeader, m_userDataPos, m_useOMPinEncoder);
+		m_encoder->SetEffort(m_encoderEffort);
 		if (m_favorSpeedOverSize) m_encoder->FavorSpeedOverSize();
 
 	#ifdef __PGFROISUPPORT__
@@ -1385,11 +1863,13 @@ void CPGFImage::SetColorTable(UINT32 iFirstColor, UINT32 nColors, const RGBQUAD*
 // The sequence of input channels in the input image buffer does not need to be the same as expected from PGF. In case of different sequences you have to
 // provide a channelMap of size of expected channels (depending on image mode). For example, PGF expects in RGB color mode a channel sequence BGR.
 // If your provided image buffer contains a channel sequence ARGB, then the channelMap looks like { 3, 2, 1 }.
-void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], CallbackPtr cb, void *data /*=nullptr*/) {
+//
+// nRows rows are converted and stored in the given channels, starting at their first value.
+void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], CallbackPtr cb, void *data, DataT* const channel[], UINT32 nRows) {
 	ASSERT(buff);
 	UINT32 yPos = 0, cnt = 0;
 	double percent = 0;
-	const double dP = 1.0/m_header.height;
+	const double dP = 1.0/nRows;
 	int defMap[] = { 0, 1, 2, 3, 4, 5, 6, 7 }; ASSERT(sizeof(defMap)/sizeof(defMap[0]) == MaxChannels);
 
 	if (channelMap == nullptr) channelMap = defMap;
@@ -1403,10 +1883,10 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 
 			const UINT32 w = m_header.width;
 			const UINT32 w2 = (m_header.width + 7)/8;
-			DataT* y = m_channel[0]; ASSERT(y);
+			DataT* y = channel[0]; ASSERT(y);
 
 			// new unpacked version since version 7
-			for (UINT32 h = 0; h < m_header.height; h++) {
+			for (UINT32 h = 0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1424,7 +1904,7 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 				buff += pitch;
 			}
 			/* old version: packed values: 8 pixels in 1 byte
-			for (UINT32 h = 0; h < m_header.height; h++) {
+			for (UINT32 h = 0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1453,7 +1933,7 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			ASSERT(bpp%8 == 0);
 			const int channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1462,7 +1942,7 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 				cnt = 0;
 				for (UINT32 w=0; w < m_header.width; w++) {
 					for (int c=0; c < m_header.channels; c++) {
-						m_channel[c][yPos] = buff[cnt + channelMap[c]] - YUVoffset8;
+						channel[c][yPos] = buff[cnt + channelMap[c]] - YUVoffset8;
 					}
 					cnt += channels;
 					yPos++;
@@ -1484,7 +1964,7 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			const int shift = 16 - UsedBitsPerChannel(); ASSERT(shift >= 0);
 			const DataT yuvOffset16 = 1 << (UsedBitsPerChannel() - 1);
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1493,7 +1973,7 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 				cnt = 0;
 				for (UINT32 w=0; w < m_header.width; w++) {
 					for (int c=0; c < m_header.channels; c++) {
-						m_channel[c][yPos] = (buff16[cnt + channelMap[c]] >> shift) - yuvOffset16;
+						channel[c][yPos] = (buff16[cnt + channelMap[c]] >> shift) - yuvOffset16;
 					}
 					cnt += channels;
 					yPos++;
@@ -1508,13 +1988,13 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			ASSERT(m_header.bpp == m_header.channels*8);
 			ASSERT(bpp%8 == 0);
 
-			DataT* y = m_channel[0]; ASSERT(y);
-			DataT* u = m_channel[1]; ASSERT(u);
-			DataT* v = m_channel[2]; ASSERT(v);
+			DataT* y = channel[0]; ASSERT(y);
+			DataT* u = channel[1]; ASSERT(u);
+			DataT* v = channel[2]; ASSERT(v);
 			const int channels = bpp/8; ASSERT(channels >= m_header.channels);
 			UINT8 b, g, r;
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1548,12 +2028,12 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			const int shift = 16 - UsedBitsPerChannel(); ASSERT(shift >= 0);
 			const DataT yuvOffset16 = 1 << (UsedBitsPerChannel() - 1);
 
-			DataT* y = m_channel[0]; ASSERT(y);
-			DataT* u = m_channel[1]; ASSERT(u);
-			DataT* v = m_channel[2]; ASSERT(v);
+			DataT* y = channel[0]; ASSERT(y);
+			DataT* u = channel[1]; ASSERT(u);
+			DataT* v = channel[2]; ASSERT(v);
 			UINT16 b, g, r;
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1583,13 +2063,13 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			ASSERT(bpp%8 == 0);
 			const int channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-			DataT* y = m_channel[0]; ASSERT(y);
-			DataT* u = m_channel[1]; ASSERT(u);
-			DataT* v = m_channel[2]; ASSERT(v);
-			DataT* a = m_channel[3]; ASSERT(a);
+			DataT* y = channel[0]; ASSERT(y);
+			DataT* u = channel[1]; ASSERT(u);
+			DataT* v = channel[2]; ASSERT(v);
+			DataT* a = channel[3]; ASSERT(a);
 			UINT8 b, g, r;
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1623,13 +2103,13 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			const int shift = 16 - UsedBitsPerChannel(); ASSERT(shift >= 0);
 			const DataT yuvOffset16 = 1 << (UsedBitsPerChannel() - 1);
 
-			DataT* y = m_channel[0]; ASSERT(y);
-			DataT* u = m_channel[1]; ASSERT(u);
-			DataT* v = m_channel[2]; ASSERT(v);
-			DataT* a = m_channel[3]; ASSERT(a);
+			DataT* y = channel[0]; ASSERT(y);
+			DataT* u = channel[1]; ASSERT(u);
+			DataT* v = channel[2]; ASSERT(v);
+			DataT* a = channel[3]; ASSERT(a);
 			UINT16 b, g, r;
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1659,14 +2139,14 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			ASSERT(bpp == 32);
 			ASSERT(DataTSize == sizeof(UINT32));
 
-			DataT* y = m_channel[0]; ASSERT(y);
+			DataT* y = channel[0]; ASSERT(y);
 
 			UINT32 *buff32 = (UINT32 *)buff;
 			const int pitch32 = pitch/4;
 			const int shift = 31 - UsedBitsPerChannel(); ASSERT(shift >= 0);
 			const DataT yuvOffset31 = 1 << (UsedBitsPerChannel() - 1);
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1686,13 +2166,13 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			ASSERT(m_header.bpp == m_header.channels*4);
 			ASSERT(bpp == m_header.channels*4);
 
-			DataT* y = m_channel[0]; ASSERT(y);
-			DataT* u = m_channel[1]; ASSERT(u);
-			DataT* v = m_channel[2]; ASSERT(v);
+			DataT* y = channel[0]; ASSERT(y);
+			DataT* u = channel[1]; ASSERT(u);
+			DataT* v = channel[2]; ASSERT(v);
 
 			UINT8 rgb = 0, b, g, r;
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1734,15 +2214,15 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 			ASSERT(m_header.bpp == 16);
 			ASSERT(bpp == 16);
 
-			DataT* y = m_channel[0]; ASSERT(y);
-			DataT* u = m_channel[1]; ASSERT(u);
-			DataT* v = m_channel[2]; ASSERT(v);
+			DataT* y = channel[0]; ASSERT(y);
+			DataT* u = channel[1]; ASSERT(u);
+			DataT* v = channel[2]; ASSERT(v);
 
 			UINT16 *buff16 = (UINT16 *)buff;
 			UINT16 rgb, b, g, r;
 			const int pitch16 = pitch/2;
 
-			for (UINT32 h=0; h < m_header.height; h++) {
+			for (UINT32 h=0; h < nRows; h++) {
 				if (cb) {
 					if ((*cb)(percent, true, data)) ReturnWithError(EscapePressed);
 					percent += dP;
@@ -1768,6 +2248,109 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 	}
 }
 
+#ifdef PGF_SIMD_COLOR
+//////////////////////////////////////////////////////////////////
+// Vectorized kernels of GetBitmapRows for the most common image modes.
+// They compute exactly the same values as the scalar loops: intermediate results are truncated
+// to 16 bits and clamping is done by saturation. A kernel converts the leading pixels of a row
+// and returns their number; the remaining pixels are converted by the scalar loop.
+
+// Returns true if map contains n different byte positions of a pixel of size bytes
+static bool IsPixelPermutation(const int map[], int n, int size) {
+	int used = 0;
+	for (int i=0; i < n; i++) {
+		if (map[i] < 0 || map[i] >= size || (used & (1 << map[i]))) return false;
+		used |= 1 << map[i];
+	}
+	return true;
+}
+
+// Loads the chrominance values of 2*SimdLanes pixels starting at the even pixel x.
+// If sampled is true, then c[x/2] belongs to the pixels x and x + 1.
+inline void LoadChroma(const DataT* c, UINT32 x, bool sampled, SimdS16& c0, SimdS16& c1) {
+	if (sampled) {
+		c0 = SimdLoadDup(c + x/2);
+		c1 = SimdLoadDup(c + x/2 + SimdLanes/2);
+	} else {
+		c0 = SimdLoad(c + x);
+		c1 = SimdLoad(c + x + SimdLanes);
+	}
+}
+
+// y + offset - ((u + v) >> 2) without overflow in u + v
+inline SimdS16 YuvToGreen(SimdS16 y, SimdS16 u, SimdS16 v, SimdS16 offset) {
+	return SimdSub(SimdAdd(y, offset), SimdShiftRight(SimdAvg(u, v), 1));
+}
+
+// 8 bit BGR[A] pixels of nBytes (3 or 4) bytes; pos contains the byte positions of b, g, r[, a].
+// If a is nullptr and nBytes == 4, then the remaining byte of each pixel is left unchanged.
+static UINT32 YuvToBgr8(const DataT* y, const DataT* u, const DataT* v, const DataT* a, bool sampled, UINT8* buff, int nBytes, const int pos[], UINT32 w) {
+	const SimdS16 offset = SimdSet(YUVoffset8);
+	const SimdS16 zero = SimdSet(0);
+	const SimdS16 max8 = SimdSet(255);
+	const int keep = 6 - pos[0] - pos[1] - pos[2];
+	SimdU8 out[4];
+	UINT32 x;
+
+	for (x=0; x + 2*SimdLanes <= w; x += 2*SimdLanes) {
+		SimdS16 u0, u1, v0, v1;
+		LoadChroma(u, x, sampled, u0, u1);
+		LoadChroma(v, x, sampled, v0, v1);
+		const SimdS16 g0 = SimdMax(SimdMin(YuvToGreen(SimdLoad(y + x), u0, v0, offset), max8), zero);
+		const SimdS16 g1 = SimdMax(SimdMin(YuvToGreen(SimdLoad(y + x + SimdLanes), u1, v1, offset), max8), zero);
+		UINT8* p = buff + x*nBytes;
+
+		out[pos[0]] = SimdPackBytes(SimdAdd(v0, g0), SimdAdd(v1, g1));
+		out[pos[1]] = SimdPackBytes(g0, g1);
+		out[pos[2]] = SimdPackBytes(SimdAdd(u0, g0), SimdAdd(u1, g1));
+		if (nBytes == 3) {
+			SimdStoreInterleaved3(p, out[0], out[1], out[2]);
+		} else {
+			if (a) {
+				SimdS16 a0, a1;
+				LoadChroma(a, x, sampled, a0, a1);
+				out[pos[3]] = SimdPackBytes(SimdAdd(a0, offset), SimdAdd(a1, offset));
+			} else {
+				out[keep] = SimdLoadInterleaved4(p, keep);
+			}
+			SimdStoreInterleaved4(p, out[0], out[1], out[2], out[3]);
+		}
+	}
+	return x;
+}
+
+// 16 bit BGR pixels; pos contains the positions of b, g, r
+static UINT32 YuvToBgr16(const DataT* y, const DataT* u, const DataT* v, bool sampled, UINT16* buff, const int pos[], DataT yuvOffset, int shift, UINT32 w) {
+	const SimdS16 offset = SimdSet(yuvOffset);
+	const SimdS16 zero = SimdSet(0);
+	SimdS16 out[3];
+	UINT32 x;
+
+	for (x=0; x + SimdLanes <= w; x += SimdLanes) {
+		const SimdS16 u0 = (sampled) ? SimdLoadDup(u + x/2) : SimdLoad(u + x);
+		const SimdS16 v0 = (sampled) ? SimdLoadDup(v + x/2) : SimdLoad(v + x);
+		const SimdS16 g = YuvToGreen(SimdLoad(y + x), u0, v0, offset);
+
+		out[pos[0]] = SimdMax(SimdShiftLeft(SimdAdd(v0, g), shift), zero);
+		out[pos[1]] = SimdMax(SimdShiftLeft(g, shift), zero);
+		out[pos[2]] = SimdMax(SimdShiftLeft(SimdAdd(u0, g), shift), zero);
+		SimdStoreInterleaved3(buff + 3*x, out[0], out[1], out[2]);
+	}
+	return x;
+}
+
+// 8 bit gray values
+static UINT32 GrayToBytes(const DataT* y, UINT8* buff, UINT32 w) {
+	const SimdS16 offset = SimdSet(YUVoffset8);
+	UINT32 x;
+
+	for (x=0; x + 2*SimdLanes <= w; x += 2*SimdLanes) {
+		SimdStoreBytes(buff + x, SimdPackBytes(SimdAdd(SimdLoad(y + x), offset), SimdAdd(SimdLoad(y + x + SimdLanes), offset)));
+	}
+	return x;
+}
+#endif // PGF_SIMD_COLOR
+
 //////////////////////////////////////////////////////////////////
 // Get image data in interleaved format: (ordering of RGB data is BGR[A])
 // Upsampling, YUV to RGB transform and interleaving are done here to reduce the number
@@ -1783,9 +2366,63 @@ void CPGFImage::RgbToYuv(int pitch, UINT8* buff, BYTE bpp, int channelMap[], Cal
 // @param buff An image buffer.
 // @param bpp The number of bits per pixel used in image buffer.
 // @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
-// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
+// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row, or after each band of rows if Open MP is used. If cb returns true, then it stops proceeding.
 // @param data Data Pointer to C++ class container to host callback procedure.
 void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*= nullptr */, CallbackPtr cb /*= nullptr*/, void *data /*=nullptr*/) const {
+	ASSERT(buff);
+	UINT32 h = m_height[0]; // height of decoded image
+
+#ifdef __PGFROISUPPORT__
+	if (ROIisSupported()) h = ComputeLevelROI().Height();
+#endif
+
+#ifdef LIBPGF_USE_OPENMP
+	// bands of rows are converted in parallel
+	const int nBands = (h + BitmapBandRows - 1)/BitmapBandRows;
+
+	if (m_useOMPinDecoder && nBands > 1) {
+		volatile bool escape = false; // volatile prevents optimizations
+		UINT32 nRowsDone = 0;
+
+		#pragma omp parallel for default(shared)
+		for (int b=0; b < nBands; b++) {
+			if (!escape) {
+				const UINT32 firstRow = b*BitmapBandRows;
+				GetBitmapRows(firstRow, BitmapBandRows, pitch, buff + (int)firstRow*pitch, bpp, channelMap);
+
+				if (cb) {
+					// the callback is called after each converted band
+					#pragma omp critical
+					{
+						nRowsDone += __min(BitmapBandRows, h - firstRow);
+						if (!escape && (*cb)((double)nRowsDone/h, true, data)) escape = true;
+					}
+				}
+			}
+		}
+		if (escape) ReturnWithError(EscapePressed);
+		return;
+	}
+#endif
+
+	GetBitmapRows(0, h, pitch, buff, bpp, channelMap, cb, data);
+}
+
+//////////////////////////////////////////////////////////////////
+// Get a band of rows of the image in interleaved format (see GetBitmap).
+// Only the rows [firstRow, firstRow + nRows) of the image are written into the buffer,
+// hence a large image can be converted band by band into a small buffer.
+// Rows below the last row of the image are ignored.
+// It might throw an IOException.
+// @param firstRow The index of the first row to copy (top-down)
+// @param nRows The number of rows to copy
+// @param pitch The number of bytes of a row of the image buffer.
+// @param buff An image buffer of at least nRows rows.
+// @param bpp The number of bits per pixel used in image buffer.
+// @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
+// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
+// @param data Data Pointer to C++ class container to host callback procedure.
+void CPGFImage::GetBitmapRows(UINT32 firstRow, UINT32 nRows, int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*= nullptr */, CallbackPtr cb /*= nullptr*/, void *data /*=nullptr*/) const {
 	ASSERT(buff);
 	UINT32 w = m_width[0];  // width of decoded image
 	UINT32 h = m_height[0]; // height of decoded image
@@ -1820,7 +2457,14 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 	}
 #endif
 
-	const double dP = 1.0/h;
+	// restrict to the requested band of rows
+	ASSERT(firstRow <= h);
+	if (nRows > h - firstRow) nRows = h - firstRow;
+	const UINT32 lastRow = firstRow + nRows;
+	yOffset += firstRow*yw;
+	uOffset += ((m_downsample) ? firstRow/2 : firstRow)*uw;
+
+	const double dP = 1.0/nRows;
 	int defMap[] = { 0, 1, 2, 3, 4, 5, 6, 7 }; ASSERT(sizeof(defMap)/sizeof(defMap[0]) == MaxChannels);
 	if (channelMap == nullptr) channelMap = defMap;
 	DataT uAvg, vAvg;
@@ -1840,7 +2484,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 			if (m_preHeader.version & Version7) {
 				// new unpacked version has a little better compression ratio
 				// since version 7
-				for (i = 0; i < h; i++) {
+				for (i = firstRow; i < lastRow; i++) {
 					UINT32 cnt = 0;
 					for (j = 0; j < w2; j++) {
 						UINT8 byte = 0;
@@ -1867,8 +2511,8 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				// old versions
 				// packed pixels: 8 pixel in 1 byte of channel[0]
 				if (!(m_preHeader.version & Version5)) yw = w2; // not version 5 or 6
-				yOffset = roiOffsetX/8 + roiOffsetY*yw; // 1 byte in y contains 8 pixel values
-				for (i = 0; i < h; i++) {
+				yOffset = roiOffsetX/8 + (roiOffsetY + firstRow)*yw; // 1 byte in y contains 8 pixel values
+				for (i = firstRow; i < lastRow; i++) {
 					for (j = 0; j < w2; j++) {
 						buff[j] = Clamp8(y[yOffset + j] + YUVoffset8);
 					}
@@ -1893,11 +2537,22 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 			ASSERT(bpp%8 == 0);
 
 			UINT32 cnt, channels = bpp/8; ASSERT(channels >= m_header.channels);
+		#ifdef PGF_SIMD_COLOR
+			const bool simd = m_header.channels == 1 && channels == 1;
+		#endif
 
-			for (i=0; i < h; i++) {
+			for (i=firstRow; i < lastRow; i++) {
 				UINT32 yPos = yOffset;
 				cnt = 0;
-				for (j=0; j < w; j++) {
+				j = 0;
+			#ifdef PGF_SIMD_COLOR
+				if (simd) {
+					j = GrayToBytes(m_channel[0] + yPos, buff, w);
+					yPos += j;
+					cnt = j;
+				}
+			#endif
+				for (; j < w; j++) {
 					for (UINT32 c=0; c < m_header.channels; c++) {
 						buff[cnt + channelMap[c]] = Clamp8(m_channel[c][yPos] + YUVoffset8);
 					}
@@ -1928,7 +2583,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				int pitch16 = pitch/2;
 				channels = bpp/16; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 yPos = yOffset;
 					cnt = 0;
 					for (j=0; j < w; j++) {
@@ -1951,7 +2606,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				const int shift = __max(0, UsedBitsPerChannel() - 8);
 				channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 yPos = yOffset;
 					cnt = 0;
 					for (j=0; j < w; j++) {
@@ -1987,13 +2642,25 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				  *buffb = &buff[channelMap[0]];
 			UINT8 g;
 			UINT32 cnt, channels = bpp/8;
+		#ifdef PGF_SIMD_COLOR
+			const bool simd = (channels == 3 || channels == 4) && IsPixelPermutation(channelMap, 3, channels);
+		#endif
 
 			if (m_downsample) {
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
-					for (j=0; j < w; j++) {
+					j = 0;
+				#ifdef PGF_SIMD_COLOR
+					if (simd) {
+						j = YuvToBgr8(y + yPos, u + uPos, v + uPos, nullptr, true, buffb - channelMap[0], channels, channelMap, w);
+						uPos += j/2;
+						yPos += j;
+						cnt = j*channels;
+					}
+				#endif
+					for (; j < w; j++) {
 						// u and v are downsampled
 						uAvg = u[uPos];
 						vAvg = v[uPos];
@@ -2018,10 +2685,18 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				}
 
 			} else {
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					cnt = 0;
 					UINT32 yPos = yOffset;
-					for (j = 0; j < w; j++) {
+					j = 0;
+				#ifdef PGF_SIMD_COLOR
+					if (simd) {
+						j = YuvToBgr8(y + yPos, u + yPos, v + yPos, nullptr, false, buffb - channelMap[0], channels, channelMap, w);
+						yPos += j;
+						cnt = j*channels;
+					}
+				#endif
+					for (; j < w; j++) {
 						uAvg = u[yPos];
 						vAvg = v[yPos];
 						// Yuv
@@ -2062,12 +2737,24 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				UINT16 *buff16 = (UINT16 *)buff;
 				int pitch16 = pitch/2;
 				channels = bpp/16; ASSERT(channels >= m_header.channels);
+			#ifdef PGF_SIMD_COLOR
+				const bool simd = channels == 3 && IsPixelPermutation(channelMap, 3, 3);
+			#endif
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
-					for (j=0; j < w; j++) {
+					j = 0;
+				#ifdef PGF_SIMD_COLOR
+					if (simd) {
+						j = YuvToBgr16(y + yPos, u + uPos, v + uPos, m_downsample, buff16, channelMap, yuvOffset16, shift, w);
+						uPos += (m_downsample) ? j/2 : j;
+						yPos += j;
+						cnt = j*channels;
+					}
+				#endif
+					for (; j < w; j++) {
 						uAvg = u[uPos];
 						vAvg = v[uPos];
 						// Yuv
@@ -2093,7 +2780,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				const int shift = __max(0, UsedBitsPerChannel() - 8);
 				channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
@@ -2132,7 +2819,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 			DataT* b = m_channel[2]; ASSERT(b);
 			UINT32 cnt, channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-			for (i=0; i < h; i++) {
+			for (i=firstRow; i < lastRow; i++) {
 				UINT32 uPos = uOffset;
 				UINT32 yPos = yOffset;
 				cnt = 0;
@@ -2175,7 +2862,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				int pitch16 = pitch/2;
 				channels = bpp/16; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
@@ -2203,7 +2890,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				const int shift = __max(0, UsedBitsPerChannel() - 8);
 				channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
@@ -2242,12 +2929,24 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 			DataT* a = m_channel[3]; ASSERT(a);
 			UINT8 g, aAvg;
 			UINT32 cnt, channels = bpp/8; ASSERT(channels >= m_header.channels);
+		#ifdef PGF_SIMD_COLOR
+			const bool simd = channels == 4 && IsPixelPermutation(channelMap, 4, 4);
+		#endif
 
-			for (i=0; i < h; i++) {
+			for (i=firstRow; i < lastRow; i++) {
 				UINT32 uPos = uOffset;
 				UINT32 yPos = yOffset;
 				cnt = 0;
-				for (j=0; j < w; j++) {
+				j = 0;
+			#ifdef PGF_SIMD_COLOR
+				if (simd) {
+					j = YuvToBgr8(y + yPos, u + uPos, v + uPos, a + uPos, m_downsample, buff, channels, channelMap, w);
+					uPos += (m_downsample) ? j/2 : j;
+					yPos += j;
+					cnt = j*channels;
+				}
+			#endif
+				for (; j < w; j++) {
 					uAvg = u[uPos];
 					vAvg = v[uPos];
 					aAvg = Clamp8(a[uPos] + YUVoffset8);
@@ -2291,7 +2990,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				int pitch16 = pitch/2;
 				channels = bpp/16; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
@@ -2323,7 +3022,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				const int shift = __max(0, UsedBitsPerChannel() - 8);
 				channels = bpp/8; ASSERT(channels >= m_header.channels);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 uPos = uOffset;
 					UINT32 yPos = yOffset;
 					cnt = 0;
@@ -2367,7 +3066,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				UINT32 *buff32 = (UINT32 *)buff;
 				int pitch32 = pitch/4;
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 yPos = yOffset;
 					for (j = 0; j < w; j++) {
 						buff32[j] = Clamp31((y[yPos++] + yuvOffset31) << shift);
@@ -2387,7 +3086,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 
 				if (usedBits < 16) {
 					const int shift = 16 - usedBits;
-					for (i=0; i < h; i++) {
+					for (i=firstRow; i < lastRow; i++) {
 						UINT32 yPos = yOffset;
 						for (j = 0; j < w; j++) {
 							buff16[j] = Clamp16((y[yPos++] + yuvOffset31) << shift);
@@ -2402,7 +3101,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 					}
 				} else {
 					const int shift = __max(0, usedBits - 16);
-					for (i=0; i < h; i++) {
+					for (i=firstRow; i < lastRow; i++) {
 						UINT32 yPos = yOffset;
 						for (j = 0; j < w; j++) {
 							buff16[j] = Clamp16((y[yPos++] + yuvOffset31) >> shift);
@@ -2420,7 +3119,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 				ASSERT(bpp == 8);
 				const int shift = __max(0, UsedBitsPerChannel() - 8);
 
-				for (i=0; i < h; i++) {
+				for (i=firstRow; i < lastRow; i++) {
 					UINT32 yPos = yOffset;
 					for (j = 0; j < w; j++) {
 						buff[j] = Clamp8((y[yPos++] + yuvOffset31) >> shift);
@@ -2450,7 +3149,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 			UINT16 yval;
 			UINT32 cnt;
 
-			for (i=0; i < h; i++) {
+			for (i=firstRow; i < lastRow; i++) {
 				UINT32 yPos = yOffset;
 				cnt = 0;
 				for (j=0; j < w; j++) {
@@ -2494,7 +3193,7 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 			UINT16 *buff16 = (UINT16 *)buff;
 			int pitch16 = pitch/2;
 
-			for (i=0; i < h; i++) {
+			for (i=firstRow; i < lastRow; i++) {
 				UINT32 yPos = yOffset;
 				for (j = 0; j < w; j++) {
 					// Yuv
@@ -2520,13 +3219,13 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 #ifdef _DEBUG
 	// display ROI (RGB) in debugger
 	roiimage.width = w;
-	roiimage.height = h;
+	roiimage.height = nRows;
 	if (pitch > 0) {
 		roiimage.pitch = pitch;
 		roiimage.data = buff;
 	} else {
 		roiimage.pitch = -pitch;
-		roiimage.data = buff + (h - 1)*pitch;
+		roiimage.data = buff + (nRows - 1)*pitch;
 	}
 #endif
 
@@ -2547,18 +3246,38 @@ void CPGFImage::GetBitmap(int pitch, UINT8* buff, BYTE bpp, int channelMap[] /*=
 /// @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
 /// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
 void CPGFImage::GetYUV(int pitch, DataT* buff, BYTE bpp, int channelMap[] /*= nullptr*/, CallbackPtr cb /*= nullptr*/, void *data /*=nullptr*/) const {
+	GetYUVRows(0, m_height[0], pitch, buff, bpp, channelMap, cb, data);
+}
+
+//////////////////////////////////////////////////////////////////////
+/// Get a band of rows of the YUV image in interleaved format (see GetYUV).
+/// Only the rows [firstRow, firstRow + nRows) of the image are written into the buffer.
+/// Rows below the last row of the image are ignored.
+/// It might throw an IOException.
+/// @param firstRow The index of the first row to copy (top-down)
+/// @param nRows The number of rows to copy
+/// @param pitch The number of bytes of a row of the image buffer.
+/// @param buff An image buffer of at least nRows rows.
+/// @param bpp The number of bits per pixel used in image buffer.
+/// @param channelMap A integer array containing the mapping of PGF channel ordering to expected channel ordering.
+/// @param cb A pointer to a callback procedure. The procedure is called after each copied buffer row. If cb returns true, then it stops proceeding.
+/// @param data Data Pointer to C++ class container to host callback procedure.
+void CPGFImage::GetYUVRows(UINT32 firstRow, UINT32 nRows, int pitch, DataT* buff, BYTE bpp, int channelMap[] /*= nullptr*/, CallbackPtr cb /*= nullptr*/, void *data /*=nullptr*/) const {
 	ASSERT(buff);
 	const UINT32 w = m_width[0];
 	const UINT32 h = m_height[0];
+	ASSERT(firstRow <= h);
+	if (nRows > h - firstRow) nRows = h - firstRow;
+	const UINT32 lastRow = firstRow + nRows;
 	const bool wOdd = (1 == w%2);
 	const int dataBits = DataTSize*8; ASSERT(dataBits == 16 || dataBits == 32);
 	const int pitch2 = pitch/DataTSize;
 	const int yuvOffset = (dataBits == 16) ? YUVoffset8 : YUVoffset16;
-	const double dP = 1.0/h;
+	const double dP = 1.0/nRows;
 
 	int defMap[] = { 0, 1, 2, 3, 4, 5, 6, 7 }; ASSERT(sizeof(defMap)/sizeof(defMap[0]) == MaxChannels);
 	if (channelMap == nullptr) channelMap = defMap;
-	int sampledPos = 0, yPos = 0;
+	int sampledPos = ((firstRow + 1)/2)*((w + 1)/2), yPos = firstRow*w;
 	DataT uAvg, vAvg;
 	double percent = 0;
 	UINT32 i, j;
@@ -2571,7 +3290,7 @@ void CPGFImage::GetYUV(int pitch, DataT* buff, BYTE bpp, int channelMap[] /*= nu
 		DataT* v = m_channel[2]; ASSERT(v);
 		int cnt, channels = bpp/dataBits; ASSERT(channels >= m_header.channels);
 
-		for (i=0; i < h; i++) {
+		for (i=firstRow; i < lastRow; i++) {
 			if (i%2) sampledPos -= (w + 1)/2;
 			cnt = 0;
 			for (j=0; j < w; j++) {
@@ -2609,7 +3328,7 @@ void CPGFImage::GetYUV(int pitch, DataT* buff, BYTE bpp, int channelMap[] /*= nu
 		UINT8 aAvg;
 		int cnt, channels = bpp/dataBits; ASSERT(channels >= m_header.channels);
 
-		for (i=0; i < h; i++) {
+		for (i=firstRow; i < lastRow; i++) {
 			if (i%2) sampledPos -= (w + 1)/2;
 			cnt = 0;
 			for (j=0; j < w; j++) {
@@ -30,18 +30,105 @@
 
 #ifdef WIN32
 #include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 //////////////////////////////////////////////////////////////////////
 // CPGFFileStream
+//////////////////////////////////////////////////////////////////////
+/// Constructor
+/// @param hFile File handle
+/// @param bufferSize Size of stream buffer in bytes (0: unbuffered)
+CPGFFileStream::CPGFFileStream(HANDLE hFile, UINT32 bufferSize /*= 0*/)
+: m_hFile(hFile)
+, m_buffer(nullptr)
+, m_bufferSize(bufferSize)
+, m_bufferLen(0)
+, m_bufferPos(0)
+, m_bufferStart(0)
+, m_dirty(false) {
+	if (m_bufferSize) {
+		m_buffer = new(std::nothrow) UINT8[m_bufferSize];
+		if (!m_buffer) ReturnWithError(InsufficientMemory);
+		if (IsValid()) {
+			OSError err;
+			if ((err = GetFPos(m_hFile, &m_bufferStart)) != NoError) ReturnWithError(err);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+CPGFFileStream::~CPGFFileStream() {
+	if (m_buffer) {
+		try {
+			if (IsValid()) Flush();
+		} catch(IOException&) {
+			// destructors must not throw: call Flush() to get write errors
+		}
+		delete[] m_buffer; m_buffer = nullptr;
+	}
+	m_hFile = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Write written bytes of the stream buffer into the file.
+void CPGFFileStream::WriteBuffer() {
+	ASSERT(m_dirty);
+	ASSERT(m_bufferPos == m_bufferLen);
+	OSError err;
+	int count = m_bufferLen;
+
+	m_dirty = false;
+	if ((err = FileWrite(m_hFile, &count, m_buffer)) != NoError) ReturnWithError(err);
+	if (count != (int)m_bufferLen) ReturnWithError(MissingData);
+	m_bufferStart += m_bufferLen;
+	m_bufferLen = m_bufferPos = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Write buffered bytes into file and set the file position to the stream position.
+void CPGFFileStream::Flush() {
+	ASSERT(IsValid());
+
+	if (m_dirty) {
+		WriteBuffer();
+	} else if (m_bufferLen) {
+		// discard read buffer
+		OSError err;
+		m_bufferStart += m_bufferPos;
+		m_bufferLen = m_bufferPos = 0;
+		if ((err = SetFPos(m_hFile, FSFromStart, m_bufferStart)) != NoError) ReturnWithError(err);
+	}
+}
+
 //////////////////////////////////////////////////////////////////////
 void CPGFFileStream::Write(int *count, void *buffPtr) {
 	ASSERT(count);
 	ASSERT(buffPtr);
 	ASSERT(IsValid());
 	OSError err;
-	if ((err = FileWrite(m_hFile, count, buffPtr)) != NoError) ReturnWithError(err);
 
+	if (m_buffer) {
+		if (!m_dirty) Flush(); // discard read buffer
+		if (m_bufferPos + *count <= m_bufferSize) {
+			// collect small writes
+			memcpy(m_buffer + m_bufferPos, buffPtr, *count);
+			m_bufferLen = m_bufferPos += *count;
+			m_dirty = true;
+			return;
+		}
+		if (m_dirty) WriteBuffer();
+		if ((UINT32)*count < m_bufferSize) {
+			memcpy(m_buffer, buffPtr, *count);
+			m_bufferLen = m_bufferPos = *count;
+			m_dirty = true;
+			return;
+		}
+	}
+	if ((err = FileWrite(m_hFile, count, buffPtr)) != NoError) ReturnWithError(err);
+	if (m_buffer) m_bufferStart += *count;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -50,19 +137,77 @@ void CPGFFileStream::Read(int *count, void *buffPtr) {
 	ASSERT(buffPtr);
 	ASSERT(IsValid());
 	OSError err;
-	if ((err = FileRead(m_hFile, count, buffPtr)) != NoError) ReturnWithError(err);
+
+	if (m_buffer) {
+		UINT8 *buff = (UINT8 *)buffPtr;
+		int len = *count;
+
+		if (m_dirty) WriteBuffer();
+
+		// copy buffered bytes
+		int n = __min(len, int(m_bufferLen - m_bufferPos));
+		memcpy(buff, m_buffer + m_bufferPos, n);
+		m_bufferPos += n;
+		*count = n;
+		if (n == len) return;
+		buff += n;
+		len -= n;
+
+		// the stream buffer has been consumed
+		m_bufferStart += m_bufferLen;
+		m_bufferLen = m_bufferPos = 0;
+		if ((UINT32)len >= m_bufferSize) {
+			// read large blocks directly
+			if ((err = FileRead(m_hFile, &len, buff)) != NoError) ReturnWithError(err);
+			m_bufferStart += len;
+		} else {
+			// refill stream buffer
+			n = m_bufferSize;
+			if ((err = FileRead(m_hFile, &n, m_buffer)) != NoError) ReturnWithError(err);
+			m_bufferLen = n;
+			len = __min(len, n);
+			memcpy(buff, m_buffer, len);
+			m_bufferPos = len;
+		}
+		*count += len;
+	} else {
+		if ((err = FileRead(m_hFile, count, buffPtr)) != NoError) ReturnWithError(err);
+	}
 }
 
 //////////////////////////////////////////////////////////////////////
 void CPGFFileStream::SetPos(short posMode, INT64 posOff) {
 	ASSERT(IsValid());
 	OSError err;
+
+	if (m_buffer) {
+		if (posMode == FSFromCurrent) {
+			posMode = FSFromStart;
+			posOff += GetPos();
+		}
+		if (posMode == FSFromStart && !m_dirty && posOff >= (INT64)m_bufferStart && posOff <= INT64(m_bufferStart + m_bufferLen)) {
+			// seek inside of read buffer
+			m_bufferPos = UINT32(posOff - m_bufferStart);
+			return;
+		}
+		if (m_dirty) WriteBuffer();
+		m_bufferLen = m_bufferPos = 0;
+	}
 	if ((err = SetFPos(m_hFile, posMode, posOff)) != NoError) ReturnWithError(err);
+	if (m_buffer) {
+		if (posMode == FSFromStart) {
+			m_bufferStart = posOff;
+		} else if ((err = GetFPos(m_hFile, &m_bufferStart)) != NoError) {
+			ReturnWithError(err);
+		}
+	}
 }
 
 //////////////////////////////////////////////////////////////////////
 UINT64 CPGFFileStream::GetPos() const {
 	ASSERT(IsValid());
+	if (m_buffer) return m_bufferStart + m_bufferPos;
+
 	OSError err;
 	UINT64 pos = 0;
 	if ((err = GetFPos(m_hFile, &pos)) != NoError) ReturnWithError2(err, pos);
@@ -78,7 +223,8 @@ UINT64 CPGFFileStream::GetPos() const {
 CPGFMemoryStream::CPGFMemoryStream(size_t size)
 : m_size(size)
 , m_allocated(true) {
-	m_buffer = m_pos = m_eos = new(std::nothrow) UINT8[m_size];
+	// malloc instead of new: the buffer might grow with realloc in Write
+	m_buffer = m_pos = m_eos = (UINT8 *)malloc(__max(m_size, 1));
 	if (!m_buffer) ReturnWithError(InsufficientMemory);
 }
 
@@ -107,40 +253,53 @@ void CPGFMemoryStream::Reinitialize(UINT8 *pBuffer, size_t size) {
 	}
 }
 
+//////////////////////////////////////////////////////////////////////
+/// Enlarges an allocated memory buffer to at least the given capacity
+/// @param capacity Minimum memory size in bytes
+void CPGFMemoryStream::Reserve(size_t capacity) {
+	ASSERT(IsValid());
+	if (capacity > m_size) {
+		if (!m_allocated) ReturnWithError(InsufficientMemory);
+		Resize(capacity);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// Reallocates the memory buffer and keeps the stream content.
+// On failure the old buffer remains valid.
+void CPGFMemoryStream::Resize(size_t size) {
+	ASSERT(m_allocated);
+	const size_t pos = m_pos - m_buffer;
+	const size_t eos = m_eos - m_buffer;
+
+	UINT8 *buf_tmp = (UINT8 *)realloc(m_buffer, size);
+	if (!buf_tmp) ReturnWithError(InsufficientMemory);
+	m_buffer = buf_tmp;
+	m_size = size;
+
+	// reposition m_pos and m_eos
+	m_pos = m_buffer + pos;
+	m_eos = m_buffer + eos;
+}
+
 //////////////////////////////////////////////////////////////////////
 void CPGFMemoryStream::Write(int *count, void *buffPtr) {
 	ASSERT(count);
 	ASSERT(buffPtr);
 	ASSERT(IsValid());
-	const size_t deltaSize = 0x4000 + *count;
 
-	if (m_pos + *count <= m_buffer + m_size) {
-		memcpy(m_pos, buffPtr, *count);
-		m_pos += *count;
-		if (m_pos > m_eos) m_eos = m_pos;
-	} else if (m_allocated) {
-		// memory block is too small -> reallocate a deltaSize larger block
-		size_t offset = m_pos - m_buffer;
-		UINT8 *buf_tmp = (UINT8 *)realloc(m_buffer, m_size + deltaSize);
-		if (!buf_tmp) {
-			delete[] m_buffer;
-			m_buffer = 0;
-			ReturnWithError(InsufficientMemory);
-		} else {
-			m_buffer = buf_tmp;
-		}
-		m_size += deltaSize;
-
-		// reposition m_pos
-		m_pos = m_buffer + offset;
+	if (m_pos + *count > m_buffer + m_size) {
+		if (!m_allocated) ReturnWithError(InsufficientMemory);
 
-		// write block
-		memcpy(m_pos, buffPtr, *count);
-		m_pos += *count;
-		if (m_pos > m_eos) m_eos = m_pos;
-	} else {
-		ReturnWithError(InsufficientMemory);
+		// memory block is too small -> grow geometrically (amortized constant time per byte)
+		const size_t needed = (m_pos - m_buffer) + *count;
+		Resize(__max(needed, __max(m_size + (m_size >> 1), m_size + 0x4000)));
 	}
+
+	// write block
+	memcpy(m_pos, buffPtr, *count);
+	m_pos += *count;
+	if (m_pos > m_eos) m_eos = m_pos;
 	ASSERT(m_pos <= m_eos);
 }
 
@@ -184,6 +343,65 @@ void CPGFMemoryStream::SetPos(short posMode, INT64 posOff) {
 		ReturnWithError(InvalidStreamPos);
 }
 
+//////////////////////////////////////////////////////////////////////
+// CPGFMMapStream
+//////////////////////////////////////////////////////////////////////
+/// Map the whole file read-only
+/// @param hFile File handle of a file opened for reading
+CPGFMMapStream::CPGFMMapStream(HANDLE hFile)
+#if defined(WIN32) || defined(WINCE)
+: m_hMapping(0)
+#endif
+{
+	UINT64 pos = 0;
+	OSError err;
+
+	if ((err = GetFPos(hFile, &pos)) != NoError) ReturnWithError(err);
+
+#if defined(WIN32) || defined(WINCE)
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size)) ReturnWithError(GetLastError());
+	if (size.QuadPart == 0 || (UINT64)size.QuadPart > (size_t)-1) ReturnWithError(MissingData);
+	if (pos > (UINT64)size.QuadPart) ReturnWithError(InvalidStreamPos);
+	m_hMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping) ReturnWithError(GetLastError());
+	UINT8 *buffer = (UINT8 *)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!buffer) {
+		err = GetLastError();
+		CloseHandle(m_hMapping); m_hMapping = 0;
+		ReturnWithError(err);
+	}
+	Reinitialize(buffer, (size_t)size.QuadPart);
+#else
+	struct stat st;
+	if (fstat(hFile, &st) != 0) ReturnWithError(errno);
+	if (st.st_size == 0 || (UINT64)st.st_size > (size_t)-1) ReturnWithError(MissingData);
+	if (pos > (UINT64)st.st_size) ReturnWithError(InvalidStreamPos);
+	void *buffer = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, hFile, 0);
+	if (buffer == MAP_FAILED) ReturnWithError(errno);
+	Reinitialize((UINT8 *)buffer, (size_t)st.st_size);
+#endif
+
+	m_pos = m_buffer + pos;
+}
+
+//////////////////////////////////////////////////////////////////////
+CPGFMMapStream::~CPGFMMapStream() {
+	if (m_buffer) {
+#if defined(WIN32) || defined(WINCE)
+		UnmapViewOfFile(m_buffer);
+		CloseHandle(m_hMapping);
+#else
+		munmap(m_buffer, m_size);
+#endif
+		m_buffer = m_pos = m_eos = 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+void CPGFMMapStream::Write(int * /*count*/, void * /*buffPtr*/) {
+	ReturnWithError(ReadOnlyStream);
+}
 
 //////////////////////////////////////////////////////////////////////
 // CPGFMemFileStream
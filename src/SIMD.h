@@ -0,0 +1,367 @@
+/*
+ * The Progressive Graphics File; http://www.libpgf.org
+ *
+ * This file Copyright (C) 2026 The libpgf contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LESSER GENERAL PUBLIC LICENSE
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+//////////////////////////////////////////////////////////////////////
+/// @file SIMD.h
+/// @brief Portable 128 bit SIMD operations on 16 bit integers
+/// @author The libpgf contributors
+
+#ifndef PGF_SIMD_H
+#define PGF_SIMD_H
+
+#include "PGFtypes.h"
+
+//////////////////////////////////////////////////////////////////////
+// Backend selection at compile time: SSE2 (x86) or NEON (ARM).
+// PGF_SIMD is defined if one of the backends is available.
+// All operations work on vectors of SimdLanes signed 16 bit integers,
+// loads and stores don't need aligned addresses.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PGF_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define PGF_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(PGF_SIMD_SSE2) || defined(PGF_SIMD_NEON)
+#define PGF_SIMD
+
+#define SimdLanes			8					///< number of 16 bit lanes of a SIMD vector
+
+#ifdef PGF_SIMD_SSE2
+typedef __m128i SimdS16;
+
+inline SimdS16 SimdLoad(const INT16* p)					{ return _mm_loadu_si128((const __m128i*)p); }
+inline void    SimdStore(INT16* p, SimdS16 v)			{ _mm_storeu_si128((__m128i*)p, v); }
+inline SimdS16 SimdSet(INT16 c)							{ return _mm_set1_epi16(c); }
+inline SimdS16 SimdAdd(SimdS16 a, SimdS16 b)			{ return _mm_add_epi16(a, b); }
+inline SimdS16 SimdSub(SimdS16 a, SimdS16 b)			{ return _mm_sub_epi16(a, b); }
+inline SimdS16 SimdAnd(SimdS16 a, SimdS16 b)			{ return _mm_and_si128(a, b); }
+inline SimdS16 SimdOr(SimdS16 a, SimdS16 b)				{ return _mm_or_si128(a, b); }
+inline SimdS16 SimdXor(SimdS16 a, SimdS16 b)			{ return _mm_xor_si128(a, b); }
+inline SimdS16 SimdCmpEq(SimdS16 a, SimdS16 b)			{ return _mm_cmpeq_epi16(a, b); }
+
+/// Absolute values; the magnitude of -32768 is 0x8000 (interpreted as unsigned)
+inline SimdS16 SimdAbs(SimdS16 v)						{ return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v)); }
+
+/// Unsigned shift right by 8 bits (high bytes)
+inline SimdS16 SimdHighBytes(SimdS16 v)					{ return _mm_srli_epi16(v, 8); }
+
+/// Unsigned shift right by n bits; all bits are shifted out if n > 15
+inline SimdS16 SimdShiftRightU(SimdS16 v, int n)		{ return _mm_srl_epi16(v, _mm_cvtsi32_si128(n)); }
+
+/// Lane masks of a > b (unsigned comparison)
+inline SimdS16 SimdAboveU(SimdS16 a, SimdS16 b)			{ return _mm_xor_si128(_mm_cmpeq_epi16(_mm_subs_epu16(a, b), _mm_setzero_si128()), _mm_set1_epi16(-1)); }
+
+/// Lane masks of negative values
+inline SimdS16 SimdNegative(SimdS16 v)					{ return _mm_srai_epi16(v, 15); }
+
+/// Shift left by n bits
+inline SimdS16 SimdShiftLeft(SimdS16 v, int n)			{ return _mm_sll_epi16(v, _mm_cvtsi32_si128(n)); }
+
+/// Arithmetic shift right by n bits
+inline SimdS16 SimdShiftRight(SimdS16 v, int n)			{ return _mm_sra_epi16(v, _mm_cvtsi32_si128(n)); }
+
+inline SimdS16 SimdMin(SimdS16 a, SimdS16 b)			{ return _mm_min_epi16(a, b); }
+inline SimdS16 SimdMax(SimdS16 a, SimdS16 b)			{ return _mm_max_epi16(a, b); }
+
+/// Loads SimdLanes/2 values and duplicates each of them: p[0] p[0] p[1] p[1] ...
+inline SimdS16 SimdLoadDup(const INT16* p) {
+	const __m128i v = _mm_loadl_epi64((const __m128i*)p);
+	return _mm_unpacklo_epi16(v, v);
+}
+
+/// Loads SimdLanes bytes and zero-extends them
+inline SimdS16 SimdLoadBytes(const UINT8* p)			{ return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()); }
+
+/// Loads SimdLanes low and high bytes and combines them: lo[i] | hi[i] << 8
+inline SimdS16 SimdLoadBytes(const UINT8* lo, const UINT8* hi) {
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)lo), _mm_loadl_epi64((const __m128i*)hi));
+}
+
+/// Expands the lowest SimdLanes bits to lane masks: lane i is all ones if bit i is set
+inline SimdS16 SimdExpandBits(UINT32 bits) {
+	const __m128i weights = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+	return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((short)bits), weights), weights);
+}
+
+/// Stores the low bytes of 2*SimdLanes values a, b
+inline void SimdStoreLowBytes(UINT8* p, SimdS16 a, SimdS16 b) {
+	const __m128i mask = _mm_set1_epi16(0xFF);
+	_mm_storeu_si128((__m128i*)p, _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+}
+
+//////////////////////////////////////////////////////////////////////
+// Vectors of 2*SimdLanes bytes
+typedef __m128i SimdU8;
+
+inline void SimdStoreBytes(UINT8* p, SimdU8 v)			{ _mm_storeu_si128((__m128i*)p, v); }
+
+/// Converts 2*SimdLanes values a, b to bytes with unsigned saturation
+inline SimdU8 SimdPackBytes(SimdS16 a, SimdS16 b)		{ return _mm_packus_epi16(a, b); }
+
+/// Loads 2*SimdLanes pixels of 4 interleaved bytes and returns byte k of each pixel
+inline SimdU8 SimdLoadInterleaved4(const UINT8* p, int k) {
+	const __m128i shift = _mm_cvtsi32_si128(8*k);
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i x0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)p), shift), mask);
+	const __m128i x1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)(p + 16)), shift), mask);
+	const __m128i x2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)(p + 32)), shift), mask);
+	const __m128i x3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)(p + 48)), shift), mask);
+	return _mm_packus_epi16(_mm_packs_epi32(x0, x1), _mm_packs_epi32(x2, x3));
+}
+
+/// Stores 2*SimdLanes pixels of 4 interleaved bytes: p[4*i + k] = ck[i]
+inline void SimdStoreInterleaved4(UINT8* p, SimdU8 c0, SimdU8 c1, SimdU8 c2, SimdU8 c3) {
+	const __m128i lo01 = _mm_unpacklo_epi8(c0, c1), hi01 = _mm_unpackhi_epi8(c0, c1);
+	const __m128i lo23 = _mm_unpacklo_epi8(c2, c3), hi23 = _mm_unpackhi_epi8(c2, c3);
+	_mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi16(lo01, lo23));
+	_mm_storeu_si128((__m128i*)(p + 16), _mm_unpackhi_epi16(lo01, lo23));
+	_mm_storeu_si128((__m128i*)(p + 32), _mm_unpacklo_epi16(hi01, hi23));
+	_mm_storeu_si128((__m128i*)(p + 48), _mm_unpackhi_epi16(hi01, hi23));
+}
+
+/// Removes the highest quarter of each of the 4 pixels in v and packs the remaining bytes into the low 12 bytes
+inline __m128i SimdPack3of4(__m128i v) {
+	const __m128i lo3 = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	const __m128i hi3 = _mm_set_epi32(0x0000FFFF, (int)0xFF000000, 0x0000FFFF, (int)0xFF000000);
+	const __m128i t = _mm_or_si128(_mm_and_si128(v, lo3), _mm_and_si128(_mm_srli_epi64(v, 8), hi3));
+	return _mm_or_si128(_mm_and_si128(t, _mm_set_epi32(0, 0, 0x0000FFFF, -1)), _mm_and_si128(_mm_srli_si128(t, 2), _mm_set_epi32(0, -1, (int)0xFFFF0000, 0)));
+}
+
+/// Removes the highest quarter of each of the 2 pixels in v and packs the remaining bytes into the low 12 bytes
+inline __m128i SimdPack3of4W(__m128i v) {
+	return _mm_or_si128(_mm_and_si128(v, _mm_set_epi32(0, 0, 0x0000FFFF, -1)), _mm_and_si128(_mm_srli_si128(v, 2), _mm_set_epi32(0, -1, (int)0xFFFF0000, 0)));
+}
+
+/// Stores four vectors of 12 bytes (upper 4 bytes are zero) as 48 consecutive bytes
+inline void SimdStore4x12(UINT8* p, __m128i r0, __m128i r1, __m128i r2, __m128i r3) {
+	_mm_storeu_si128((__m128i*)p, _mm_or_si128(r0, _mm_slli_si128(r1, 12)));
+	_mm_storeu_si128((__m128i*)(p + 16), _mm_or_si128(_mm_srli_si128(r1, 4), _mm_slli_si128(r2, 8)));
+	_mm_storeu_si128((__m128i*)(p + 32), _mm_or_si128(_mm_srli_si128(r2, 8), _mm_slli_si128(r3, 4)));
+}
+
+/// Stores 2*SimdLanes pixels of 3 interleaved bytes: p[3*i + k] = ck[i]
+inline void SimdStoreInterleaved3(UINT8* p, SimdU8 c0, SimdU8 c1, SimdU8 c2) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lo01 = _mm_unpacklo_epi8(c0, c1), hi01 = _mm_unpackhi_epi8(c0, c1);
+	const __m128i lo2 = _mm_unpacklo_epi8(c2, zero), hi2 = _mm_unpackhi_epi8(c2, zero);
+	SimdStore4x12(p, SimdPack3of4(_mm_unpacklo_epi16(lo01, lo2)), SimdPack3of4(_mm_unpackhi_epi16(lo01, lo2)),
+		SimdPack3of4(_mm_unpacklo_epi16(hi01, hi2)), SimdPack3of4(_mm_unpackhi_epi16(hi01, hi2)));
+}
+
+/// Stores SimdLanes pixels of 3 interleaved 16 bit values: p[3*i + k] = ck[i]
+inline void SimdStoreInterleaved3(UINT16* p, SimdS16 c0, SimdS16 c1, SimdS16 c2) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lo01 = _mm_unpacklo_epi16(c0, c1), hi01 = _mm_unpackhi_epi16(c0, c1);
+	const __m128i lo2 = _mm_unpacklo_epi16(c2, zero), hi2 = _mm_unpackhi_epi16(c2, zero);
+	SimdStore4x12((UINT8*)p, SimdPack3of4W(_mm_unpacklo_epi32(lo01, lo2)), SimdPack3of4W(_mm_unpackhi_epi32(lo01, lo2)),
+		SimdPack3of4W(_mm_unpacklo_epi32(hi01, hi2)), SimdPack3of4W(_mm_unpackhi_epi32(hi01, hi2)));
+}
+
+/// Returns the sign bits of 2*SimdLanes values a, b: bit i is set if value i is negative
+inline UINT32 SimdSignMask(SimdS16 a, SimdS16 b)		{ return (UINT32)_mm_movemask_epi8(_mm_packs_epi16(a, b)); }
+
+/// Returns the sum of all lanes
+inline int SimdSum(SimdS16 v) {
+	const __m128i s = _mm_madd_epi16(v, _mm_set1_epi16(1));
+	const __m128i t = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtsi128_si32(_mm_add_epi32(t, _mm_shuffle_epi32(t, _MM_SHUFFLE(2, 3, 0, 1))));
+}
+
+/// (a + b + 1) >> 1 without overflow: unsigned average of values biased by 0x8000
+inline SimdS16 SimdAvgRound(SimdS16 a, SimdS16 b) {
+	const __m128i bias = _mm_set1_epi16((short)0x8000);
+	return _mm_xor_si128(_mm_avg_epu16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+
+/// (a + b) >> 1 without overflow
+inline SimdS16 SimdAvg(SimdS16 a, SimdS16 b) {
+	return _mm_sub_epi16(SimdAvgRound(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi16(1)));
+}
+
+/// Splits 2*SimdLanes interleaved values x0, x1 into even and odd positions
+inline void SimdSplit(SimdS16 x0, SimdS16 x1, SimdS16& even, SimdS16& odd) {
+	even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(x0, 16), 16), _mm_srai_epi32(_mm_slli_epi32(x1, 16), 16));
+	odd = _mm_packs_epi32(_mm_srai_epi32(x0, 16), _mm_srai_epi32(x1, 16));
+}
+
+/// Interleaves even and odd values into 2*SimdLanes values lo, hi
+inline void SimdMerge(SimdS16 even, SimdS16 odd, SimdS16& lo, SimdS16& hi) {
+	lo = _mm_unpacklo_epi16(even, odd);
+	hi = _mm_unpackhi_epi16(even, odd);
+}
+#endif // PGF_SIMD_SSE2
+
+#ifdef PGF_SIMD_NEON
+typedef int16x8_t SimdS16;
+
+inline SimdS16 SimdLoad(const INT16* p)					{ return vld1q_s16(p); }
+inline void    SimdStore(INT16* p, SimdS16 v)			{ vst1q_s16(p, v); }
+inline SimdS16 SimdSet(INT16 c)							{ return vdupq_n_s16(c); }
+inline SimdS16 SimdAdd(SimdS16 a, SimdS16 b)			{ return vaddq_s16(a, b); }
+inline SimdS16 SimdSub(SimdS16 a, SimdS16 b)			{ return vsubq_s16(a, b); }
+inline SimdS16 SimdAnd(SimdS16 a, SimdS16 b)			{ return vandq_s16(a, b); }
+inline SimdS16 SimdOr(SimdS16 a, SimdS16 b)				{ return vorrq_s16(a, b); }
+inline SimdS16 SimdXor(SimdS16 a, SimdS16 b)			{ return veorq_s16(a, b); }
+inline SimdS16 SimdCmpEq(SimdS16 a, SimdS16 b)			{ return vreinterpretq_s16_u16(vceqq_s16(a, b)); }
+
+/// Absolute values; the magnitude of -32768 is 0x8000 (interpreted as unsigned)
+inline SimdS16 SimdAbs(SimdS16 v)						{ return vabsq_s16(v); }
+
+/// Unsigned shift right by 8 bits (high bytes)
+inline SimdS16 SimdHighBytes(SimdS16 v)					{ return vreinterpretq_s16_u16(vshrq_n_u16(vreinterpretq_u16_s16(v), 8)); }
+
+/// Unsigned shift right by n bits; all bits are shifted out if n > 15
+inline SimdS16 SimdShiftRightU(SimdS16 v, int n)		{ return vreinterpretq_s16_u16(vshlq_u16(vreinterpretq_u16_s16(v), vdupq_n_s16((INT16)-n))); }
+
+/// Lane masks of a > b (unsigned comparison)
+inline SimdS16 SimdAboveU(SimdS16 a, SimdS16 b)			{ return vreinterpretq_s16_u16(vcgtq_u16(vreinterpretq_u16_s16(a), vreinterpretq_u16_s16(b))); }
+
+/// Lane masks of negative values
+inline SimdS16 SimdNegative(SimdS16 v)					{ return vshrq_n_s16(v, 15); }
+
+/// Shift left by n bits
+inline SimdS16 SimdShiftLeft(SimdS16 v, int n)			{ return vshlq_s16(v, vdupq_n_s16((INT16)n)); }
+
+/// Arithmetic shift right by n bits
+inline SimdS16 SimdShiftRight(SimdS16 v, int n)			{ return vshlq_s16(v, vdupq_n_s16((INT16)-n)); }
+
+inline SimdS16 SimdMin(SimdS16 a, SimdS16 b)			{ return vminq_s16(a, b); }
+inline SimdS16 SimdMax(SimdS16 a, SimdS16 b)			{ return vmaxq_s16(a, b); }
+
+/// Loads SimdLanes/2 values and duplicates each of them: p[0] p[0] p[1] p[1] ...
+inline SimdS16 SimdLoadDup(const INT16* p) {
+	const int16x4x2_t r = vzip_s16(vld1_s16(p), vld1_s16(p));
+	return vcombine_s16(r.val[0], r.val[1]);
+}
+
+/// Loads SimdLanes bytes and zero-extends them
+inline SimdS16 SimdLoadBytes(const UINT8* p)			{ return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p))); }
+
+/// Loads SimdLanes low and high bytes and combines them: lo[i] | hi[i] << 8
+inline SimdS16 SimdLoadBytes(const UINT8* lo, const UINT8* hi) {
+	const uint8x8x2_t r = vzip_u8(vld1_u8(lo), vld1_u8(hi));
+	return vreinterpretq_s16_u8(vcombine_u8(r.val[0], r.val[1]));
+}
+
+/// Expands the lowest SimdLanes bits to lane masks: lane i is all ones if bit i is set
+inline SimdS16 SimdExpandBits(UINT32 bits) {
+	static const UINT16 weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	return vreinterpretq_s16_u16(vtstq_u16(vdupq_n_u16((UINT16)bits), vld1q_u16(weights)));
+}
+
+/// Stores the low bytes of 2*SimdLanes values a, b
+inline void SimdStoreLowBytes(UINT8* p, SimdS16 a, SimdS16 b) {
+	vst1q_u8(p, vcombine_u8(vmovn_u16(vreinterpretq_u16_s16(a)), vmovn_u16(vreinterpretq_u16_s16(b))));
+}
+
+//////////////////////////////////////////////////////////////////////
+// Vectors of 2*SimdLanes bytes
+typedef uint8x16_t SimdU8;
+
+inline void SimdStoreBytes(UINT8* p, SimdU8 v)			{ vst1q_u8(p, v); }
+
+/// Converts 2*SimdLanes values a, b to bytes with unsigned saturation
+inline SimdU8 SimdPackBytes(SimdS16 a, SimdS16 b)		{ return vcombine_u8(vqmovun_s16(a), vqmovun_s16(b)); }
+
+/// Loads 2*SimdLanes pixels of 4 interleaved bytes and returns byte k of each pixel
+inline SimdU8 SimdLoadInterleaved4(const UINT8* p, int k)	{ return vld4q_u8(p).val[k]; }
+
+/// Stores 2*SimdLanes pixels of 4 interleaved bytes: p[4*i + k] = ck[i]
+inline void SimdStoreInterleaved4(UINT8* p, SimdU8 c0, SimdU8 c1, SimdU8 c2, SimdU8 c3) {
+	uint8x16x4_t r;
+	r.val[0] = c0; r.val[1] = c1; r.val[2] = c2; r.val[3] = c3;
+	vst4q_u8(p, r);
+}
+
+/// Stores 2*SimdLanes pixels of 3 interleaved bytes: p[3*i + k] = ck[i]
+inline void SimdStoreInterleaved3(UINT8* p, SimdU8 c0, SimdU8 c1, SimdU8 c2) {
+	uint8x16x3_t r;
+	r.val[0] = c0; r.val[1] = c1; r.val[2] = c2;
+	vst3q_u8(p, r);
+}
+
+/// Stores SimdLanes pixels of 3 interleaved 16 bit values: p[3*i + k] = ck[i]
+inline void SimdStoreInterleaved3(UINT16* p, SimdS16 c0, SimdS16 c1, SimdS16 c2) {
+	uint16x8x3_t r;
+	r.val[0] = vreinterpretq_u16_s16(c0); r.val[1] = vreinterpretq_u16_s16(c1); r.val[2] = vreinterpretq_u16_s16(c2);
+	vst3q_u16(p, r);
+}
+
+/// Returns the sign bits of 2*SimdLanes values a, b: bit i is set if value i is negative
+inline UINT32 SimdSignMask(SimdS16 a, SimdS16 b) {
+	static const UINT16 weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	const uint16x8_t w = vld1q_u16(weights);
+	const uint16x8_t ma = vandq_u16(vreinterpretq_u16_s16(vshrq_n_s16(a, 15)), w);
+	const uint16x8_t mb = vandq_u16(vreinterpretq_u16_s16(vshrq_n_s16(b, 15)), vshlq_n_u16(w, 8));
+	const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vorrq_u16(ma, mb)));
+	return (UINT32)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+}
+
+/// Returns the sum of all lanes
+inline int SimdSum(SimdS16 v) {
+	const int64x2_t s = vpaddlq_s32(vpaddlq_s16(v));
+	return (int)(vgetq_lane_s64(s, 0) + vgetq_lane_s64(s, 1));
+}
+
+/// (a + b + 1) >> 1 without overflow
+inline SimdS16 SimdAvgRound(SimdS16 a, SimdS16 b)		{ return vrhaddq_s16(a, b); }
+
+/// (a + b) >> 1 without overflow
+inline SimdS16 SimdAvg(SimdS16 a, SimdS16 b)			{ return vhaddq_s16(a, b); }
+
+/// Splits 2*SimdLanes interleaved values x0, x1 into even and odd positions
+inline void SimdSplit(SimdS16 x0, SimdS16 x1, SimdS16& even, SimdS16& odd) {
+	const int16x8x2_t r = vuzpq_s16(x0, x1);
+	even = r.val[0];
+	odd = r.val[1];
+}
+
+/// Interleaves even and odd values into 2*SimdLanes values lo, hi
+inline void SimdMerge(SimdS16 even, SimdS16 odd, SimdS16& lo, SimdS16& hi) {
+	const int16x8x2_t r = vzipq_s16(even, odd);
+	lo = r.val[0];
+	hi = r.val[1];
+}
+#endif // PGF_SIMD_NEON
+
+//////////////////////////////////////////////////////////////////////
+// Wider x86 instruction sets are compiled with target attributes (GCC, Clang)
+// and have to be selected at runtime with SimdCpuLevel().
+#if defined(PGF_SIMD_SSE2) && defined(__GNUC__)
+#define PGF_SIMD_AVX
+#include <immintrin.h>
+
+enum SimdLevel { SimdBase, SimdAVX2, SimdAVX512 };
+
+/// Returns the widest instruction set supported by the CPU (AVX-512 requires AVX512BW)
+inline SimdLevel SimdCpuLevel() {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw")) return SimdAVX512;
+	if (__builtin_cpu_supports("avx2")) return SimdAVX2;
+	return SimdBase;
+}
+#endif // PGF_SIMD_AVX
+
+#endif // PGF_SIMD
+
+#endif // PGF_SIMD_H
@@ -27,6 +27,7 @@
 /// @author C. Stamm
 
 #include "Subband.h"
+#include "SIMD.h"
 #include "Encoder.h"
 #include "Decoder.h"
 
@@ -74,23 +75,28 @@ void CSubband::Initialize(UINT32 width, UINT32 height, int level, Orientation or
 /////////////////////////////////////////////////////////////////////
 // Allocate a memory buffer to store all wavelet coefficients of this subband.
 // @return True if the allocation works without any problems
+// An allocated buffer of sufficient size is kept without changing any member,
+// hence tiles of an allocated subband can be placed concurrently.
 bool CSubband::AllocMemory() {
-	UINT32 oldSize = m_size;
+	UINT32 size = m_size;
 
 #ifdef __PGFROISUPPORT__
-	m_size = BufferWidth()*m_ROI.Height();
+	size = BufferWidth()*m_ROI.Height();
 #endif
-	ASSERT(m_size > 0);
+	ASSERT(size > 0);
 
 	if (m_data) {
-		if (oldSize >= m_size) {
+		if (m_size >= size) {
+			if (m_size != size) m_size = size;
 			return true;
 		} else {
 			delete[] m_data;
+			m_size = size;
 			m_data = new(std::nothrow) DataT[m_size];
 			return (m_data != 0);
 		}
 	} else {
+		m_size = size;
 		m_data = new(std::nothrow) DataT[m_size];
 		return (m_data != 0);
 	}
@@ -105,43 +111,59 @@ void CSubband::FreeMemory() {
 }
 
 /////////////////////////////////////////////////////////////////////
-// Perform subband quantization with given quantization parameter.
-// A scalar quantization (with dead-zone) is used. A large quantization value
-// results in strong quantization and therefore in big quality loss.
+// Returns the quantization shift of this subband for a given quantization parameter.
+// LL subbands use uniform rounding quantization (threshold 0),
+// all other subbands use uniform deadzone quantization.
 // @param quantParam A quantization parameter (larger or equal to 0)
-void CSubband::Quantize(int quantParam) {
+// @param threshold [out] Values of magnitude up to threshold are quantized to 0
+// @return Quantization shift or -1 if this subband is not quantized
+int CSubband::QuantizationShift(int quantParam, int& threshold) const {
+	threshold = 0;
 	if (m_orientation == LL) {
 		quantParam -= (m_level + 1);
-		// uniform rounding quantization
-		if (quantParam > 0) {
-			quantParam--;
-			for (UINT32 i=0; i < m_size; i++) {
-				if (m_data[i] < 0) {
-					m_data[i] = -(((-m_data[i] >> quantParam) + 1) >> 1);
-				} else {
-					m_data[i] = ((m_data[i] >> quantParam) + 1) >> 1;
-				}
-			}
-		}
+	} else if (m_orientation == HH) {
+		quantParam -= (m_level - 1);
 	} else {
-		if (m_orientation == HH) {
-			quantParam -= (m_level - 1);
+		quantParam -= m_level;
+	}
+	if (quantParam <= 0) return -1;
+	if (m_orientation != LL) threshold = ((1 << quantParam) * 7)/5;	// good value
+	return quantParam - 1;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Quantizes len values of this subband starting at buffer position pos.
+// Values of magnitude above threshold: sign(v)*(((|v| >> shift) + 1) >> 1), all other values: 0
+// @param pos Buffer position
+// @param len Number of values
+// @param shift Quantization shift (see QuantizationShift)
+// @param threshold Dead zone threshold (see QuantizationShift)
+void CSubband::QuantizeRange(UINT32 pos, UINT32 len, int shift, int threshold) {
+	ASSERT(shift >= 0);
+	ASSERT(pos + len <= m_size);
+	DataT* data = m_data + pos;
+	UINT32 i = 0;
+
+#if defined(PGF_SIMD) && !defined(__PGF32SUPPORT__)
+	// magnitudes are compared and shifted as unsigned values: the magnitude of -32768 is 0x8000
+	const SimdS16 t = SimdSet((INT16)__min(threshold, 0x8000));
+	const SimdS16 one = SimdSet(1);
+	for (; i + SimdLanes <= len; i += SimdLanes) {
+		const SimdS16 v = SimdLoad(data + i);
+		const SimdS16 a = SimdAbs(v);
+		const SimdS16 neg = SimdNegative(v);
+		SimdS16 q = SimdShiftRightU(SimdAdd(SimdShiftRightU(a, shift), one), 1);
+		q = SimdSub(SimdXor(q, neg), neg);
+		SimdStore(data + i, SimdAnd(q, SimdAboveU(a, t)));
+	}
+#endif
+	for (; i < len; i++) {
+		if (data[i] < -threshold) {
+			data[i] = -(((-data[i] >> shift) + 1) >> 1);
+		} else if (data[i] > threshold) {
+			data[i] = ((data[i] >> shift) + 1) >> 1;
 		} else {
-			quantParam -= m_level;
-		}
-		// uniform deadzone quantization
-		if (quantParam > 0) {
-			int threshold = ((1 << quantParam) * 7)/5;	// good value
-			quantParam--;
-			for (UINT32 i=0; i < m_size; i++) {
-				if (m_data[i] < -threshold) {
-					m_data[i] = -(((-m_data[i] >> quantParam) + 1) >> 1);
-				} else if (m_data[i] > threshold) {
-					m_data[i] = ((m_data[i] >> quantParam) + 1) >> 1;
-				} else {
-					m_data[i] = 0;
-				}
-			}
+			data[i] = 0;
 		}
 	}
 }
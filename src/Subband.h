@@ -81,13 +81,6 @@ public:
 	/// @param tileY Tile index in y-direction
 	void PlaceTile(CDecoder& decoder, int quantParam, bool tile = false, UINT32 tileX = 0, UINT32 tileY = 0);
 
-	//////////////////////////////////////////////////////////////////////
-	/// Perform subband quantization with given quantization parameter.
-	/// A scalar quantization (with dead-zone) is used. A large quantization value
-	/// results in strong quantization and therefore in big quality loss.
-	/// @param quantParam A quantization parameter (larger or equal to 0)
-	void Quantize(int quantParam);
-
 	//////////////////////////////////////////////////////////////////////
 	/// Perform subband dequantization with given quantization parameter.
 	/// A scalar quantization (with dead-zone) is used. A large quantization value
@@ -145,6 +138,8 @@ public:
 private:
 	void Initialize(UINT32 width, UINT32 height, int level, Orientation orient);
 	void WriteBuffer(DataT val)			{ ASSERT(m_dataPos < m_size); m_data[m_dataPos++] = val; }
+	int QuantizationShift(int quantParam, int& threshold) const;
+	void QuantizeRange(UINT32 pos, UINT32 len, int shift, int threshold);
 	void SetBuffer(DataT* b)			{ ASSERT(b); m_data = b; }
 	DataT ReadBuffer()					{ ASSERT(m_dataPos < m_size); return m_data[m_dataPos++]; }
 
@@ -178,6 +173,7 @@ private:
 	}
 
 	UINT32 GetBuffPos() const			{ return m_dataPos; }
+	void SetBuffPos(UINT32 pos)			{ ASSERT(pos <= m_size); m_dataPos = pos; }
 
 #ifdef __PGFROISUPPORT__
 	UINT32 BufferWidth() const			{ return m_ROI.Width(); }
@@ -27,10 +27,302 @@
 /// @author C. Stamm
 
 #include "WaveletTransform.h"
+#include "SIMD.h"
+#include <new>
+
+#if defined(PGF_SIMD) && !defined(__PGF32SUPPORT__)
+#define PGF_SIMD_LIFTING	// vectorized lifting kernels for 16 bit coefficients
+#endif
 
 #define c1 1	// best value 1
 #define c2 2	// best value 2
 
+//////////////////////////////////////////////////////////////////////////
+// Lifting kernels of the forward and inverse transform.
+// All lifting steps of rows and columns are expressed by element-wise kernels:
+// predict (high pass):	d[k] -= (a[k] + b[k] + c1) >> 1
+// update (low pass):	d[k] += (a[k] + b[k] + c2) >> 2
+// The inverse kernels undo these steps (d[k] += ... and d[k] -= ..., respectively).
+// Vectorized rows are split into even (low) and odd (high) positions before lifting;
+// scalar rows are lifted in place (Split == nullptr).
+// The vectorized kernels compute without intermediate overflow and deliver
+// exactly the results of the scalar kernels.
+struct LiftingKernels {
+	void (*Predict)(DataT* d, const DataT* a, const DataT* b, UINT32 n);
+	void (*Update)(DataT* d, const DataT* a, const DataT* b, UINT32 n);
+	void (*InversePredict)(DataT* d, const DataT* a, const DataT* b, UINT32 n);
+	void (*InverseUpdate)(DataT* d, const DataT* a, const DataT* b, UINT32 n);
+	void (*Split)(const DataT* src, DataT* even, DataT* odd, UINT32 n);
+	void (*Merge)(DataT* dest, const DataT* even, const DataT* odd, UINT32 n);
+};
+
+static void PredictScalar(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	for (UINT32 k=0; k < n; k++) d[k] -= ((a[k] + b[k] + c1) >> 1);
+}
+
+static void UpdateScalar(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	for (UINT32 k=0; k < n; k++) d[k] += ((a[k] + b[k] + c2) >> 2);
+}
+
+static void InversePredictScalar(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	for (UINT32 k=0; k < n; k++) d[k] += ((a[k] + b[k] + c1) >> 1);
+}
+
+static void InverseUpdateScalar(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	for (UINT32 k=0; k < n; k++) d[k] -= ((a[k] + b[k] + c2) >> 2);
+}
+
+#ifdef PGF_SIMD_LIFTING
+// (a + b + 2) >> 2 == (((a + b) >> 1) + 1) >> 1
+
+//////////////////////////////////////////////////////////////////////////
+// Portable 128 bit kernels (SSE2 or NEON)
+static void PredictSimd(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + SimdLanes <= n; k += SimdLanes) {
+		SimdStore(d + k, SimdSub(SimdLoad(d + k), SimdAvgRound(SimdLoad(a + k), SimdLoad(b + k))));
+	}
+	PredictScalar(d + k, a + k, b + k, n - k);
+}
+
+static void UpdateSimd(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	const SimdS16 zero = SimdSet(0);
+	UINT32 k = 0;
+	for (; k + SimdLanes <= n; k += SimdLanes) {
+		SimdStore(d + k, SimdAdd(SimdLoad(d + k), SimdAvgRound(SimdAvg(SimdLoad(a + k), SimdLoad(b + k)), zero)));
+	}
+	UpdateScalar(d + k, a + k, b + k, n - k);
+}
+
+static void InversePredictSimd(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + SimdLanes <= n; k += SimdLanes) {
+		SimdStore(d + k, SimdAdd(SimdLoad(d + k), SimdAvgRound(SimdLoad(a + k), SimdLoad(b + k))));
+	}
+	InversePredictScalar(d + k, a + k, b + k, n - k);
+}
+
+static void InverseUpdateSimd(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	const SimdS16 zero = SimdSet(0);
+	UINT32 k = 0;
+	for (; k + SimdLanes <= n; k += SimdLanes) {
+		SimdStore(d + k, SimdSub(SimdLoad(d + k), SimdAvgRound(SimdAvg(SimdLoad(a + k), SimdLoad(b + k)), zero)));
+	}
+	InverseUpdateScalar(d + k, a + k, b + k, n - k);
+}
+
+static void SplitSimd(const DataT* src, DataT* even, DataT* odd, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + SimdLanes <= n; k += SimdLanes) {
+		SimdS16 e, o;
+		SimdSplit(SimdLoad(src + 2*k), SimdLoad(src + 2*k + SimdLanes), e, o);
+		SimdStore(even + k, e);
+		SimdStore(odd + k, o);
+	}
+	for (; k < n; k++) {
+		even[k] = src[2*k];
+		odd[k] = src[2*k + 1];
+	}
+}
+
+static void MergeSimd(DataT* dest, const DataT* even, const DataT* odd, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + SimdLanes <= n; k += SimdLanes) {
+		SimdS16 lo, hi;
+		SimdMerge(SimdLoad(even + k), SimdLoad(odd + k), lo, hi);
+		SimdStore(dest + 2*k, lo);
+		SimdStore(dest + 2*k + SimdLanes, hi);
+	}
+	for (; k < n; k++) {
+		dest[2*k] = even[k];
+		dest[2*k + 1] = odd[k];
+	}
+}
+#endif // PGF_SIMD_LIFTING
+
+#if defined(PGF_SIMD_LIFTING) && defined(PGF_SIMD_AVX)
+// Signed rounding averages are computed with the unsigned average instruction (pavgw)
+// on values biased by 0x8000: avg(a + 0x8000, b + 0x8000) = ((a + b + 1) >> 1) + 0x8000.
+
+//////////////////////////////////////////////////////////////////////////
+// AVX2
+__attribute__((target("avx2")))
+static inline __m256i AvgRoundAVX2(__m256i a, __m256i b) {
+	const __m256i bias = _mm256_set1_epi16((short)0x8000);
+	return _mm256_xor_si256(_mm256_avg_epu16(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias)), bias);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i AvgRound2AVX2(__m256i a, __m256i b) {
+	const __m256i h = _mm256_sub_epi16(AvgRoundAVX2(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi16(1)));
+	return AvgRoundAVX2(h, _mm256_setzero_si256());
+}
+
+#define LoadAVX2(p)			_mm256_loadu_si256((const __m256i*)(p))
+#define StoreAVX2(p, v)		_mm256_storeu_si256((__m256i*)(p), v)
+
+__attribute__((target("avx2")))
+static void PredictAVX2(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 16 <= n; k += 16) StoreAVX2(d + k, _mm256_sub_epi16(LoadAVX2(d + k), AvgRoundAVX2(LoadAVX2(a + k), LoadAVX2(b + k))));
+	PredictSimd(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx2")))
+static void UpdateAVX2(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 16 <= n; k += 16) StoreAVX2(d + k, _mm256_add_epi16(LoadAVX2(d + k), AvgRound2AVX2(LoadAVX2(a + k), LoadAVX2(b + k))));
+	UpdateSimd(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx2")))
+static void InversePredictAVX2(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 16 <= n; k += 16) StoreAVX2(d + k, _mm256_add_epi16(LoadAVX2(d + k), AvgRoundAVX2(LoadAVX2(a + k), LoadAVX2(b + k))));
+	InversePredictSimd(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx2")))
+static void InverseUpdateAVX2(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 16 <= n; k += 16) StoreAVX2(d + k, _mm256_sub_epi16(LoadAVX2(d + k), AvgRound2AVX2(LoadAVX2(a + k), LoadAVX2(b + k))));
+	InverseUpdateSimd(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx2")))
+static void SplitAVX2(const DataT* src, DataT* even, DataT* odd, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 16 <= n; k += 16) {
+		const __m256i x0 = LoadAVX2(src + 2*k);
+		const __m256i x1 = LoadAVX2(src + 2*k + 16);
+		const __m256i e0 = _mm256_srai_epi32(_mm256_slli_epi32(x0, 16), 16);
+		const __m256i e1 = _mm256_srai_epi32(_mm256_slli_epi32(x1, 16), 16);
+		// packs works within 128 bit lanes: reorder 64 bit quarters
+		StoreAVX2(even + k, _mm256_permute4x64_epi64(_mm256_packs_epi32(e0, e1), 0xD8));
+		StoreAVX2(odd + k, _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srai_epi32(x0, 16), _mm256_srai_epi32(x1, 16)), 0xD8));
+	}
+	SplitSimd(src + 2*k, even + k, odd + k, n - k);
+}
+
+__attribute__((target("avx2")))
+static void MergeAVX2(DataT* dest, const DataT* even, const DataT* odd, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 16 <= n; k += 16) {
+		const __m256i e = LoadAVX2(even + k);
+		const __m256i o = LoadAVX2(odd + k);
+		const __m256i lo = _mm256_unpacklo_epi16(e, o);
+		const __m256i hi = _mm256_unpackhi_epi16(e, o);
+		// unpack works within 128 bit lanes: combine lanes
+		StoreAVX2(dest + 2*k, _mm256_permute2x128_si256(lo, hi, 0x20));
+		StoreAVX2(dest + 2*k + 16, _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	MergeSimd(dest + 2*k, even + k, odd + k, n - k);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AVX-512 (requires AVX512BW for 16 bit elements)
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i AvgRoundAVX512(__m512i a, __m512i b) {
+	const __m512i bias = _mm512_set1_epi16((short)0x8000);
+	return _mm512_xor_si512(_mm512_avg_epu16(_mm512_xor_si512(a, bias), _mm512_xor_si512(b, bias)), bias);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i AvgRound2AVX512(__m512i a, __m512i b) {
+	const __m512i h = _mm512_sub_epi16(AvgRoundAVX512(a, b), _mm512_and_si512(_mm512_xor_si512(a, b), _mm512_set1_epi16(1)));
+	return AvgRoundAVX512(h, _mm512_setzero_si512());
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void PredictAVX512(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 32 <= n; k += 32) _mm512_storeu_si512(d + k, _mm512_sub_epi16(_mm512_loadu_si512(d + k), AvgRoundAVX512(_mm512_loadu_si512(a + k), _mm512_loadu_si512(b + k))));
+	PredictAVX2(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void UpdateAVX512(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 32 <= n; k += 32) _mm512_storeu_si512(d + k, _mm512_add_epi16(_mm512_loadu_si512(d + k), AvgRound2AVX512(_mm512_loadu_si512(a + k), _mm512_loadu_si512(b + k))));
+	UpdateAVX2(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void InversePredictAVX512(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 32 <= n; k += 32) _mm512_storeu_si512(d + k, _mm512_add_epi16(_mm512_loadu_si512(d + k), AvgRoundAVX512(_mm512_loadu_si512(a + k), _mm512_loadu_si512(b + k))));
+	InversePredictAVX2(d + k, a + k, b + k, n - k);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void InverseUpdateAVX512(DataT* d, const DataT* a, const DataT* b, UINT32 n) {
+	UINT32 k = 0;
+	for (; k + 32 <= n; k += 32) _mm512_storeu_si512(d + k, _mm512_sub_epi16(_mm512_loadu_si512(d + k), AvgRound2AVX512(_mm512_loadu_si512(a + k), _mm512_loadu_si512(b + k))));
+	InverseUpdateAVX2(d + k, a + k, b + k, n - k);
+}
+
+// permutation indices of 16 bit elements: even/odd positions of two vectors and their interleaving
+static const INT16 SplitEvenIdx[32] = { 0,2,4,6,8,10,12,14,16,18,20,22,24,26,28,30,32,34,36,38,40,42,44,46,48,50,52,54,56,58,60,62 };
+static const INT16 SplitOddIdx[32]  = { 1,3,5,7,9,11,13,15,17,19,21,23,25,27,29,31,33,35,37,39,41,43,45,47,49,51,53,55,57,59,61,63 };
+static const INT16 MergeLoIdx[32]   = { 0,32,1,33,2,34,3,35,4,36,5,37,6,38,7,39,8,40,9,41,10,42,11,43,12,44,13,45,14,46,15,47 };
+static const INT16 MergeHiIdx[32]   = { 16,48,17,49,18,50,19,51,20,52,21,53,22,54,23,55,24,56,25,57,26,58,27,59,28,60,29,61,30,62,31,63 };
+
+__attribute__((target("avx512f,avx512bw")))
+static void SplitAVX512(const DataT* src, DataT* even, DataT* odd, UINT32 n) {
+	const __m512i evenIdx = _mm512_loadu_si512(SplitEvenIdx);
+	const __m512i oddIdx = _mm512_loadu_si512(SplitOddIdx);
+	UINT32 k = 0;
+	for (; k + 32 <= n; k += 32) {
+		const __m512i x0 = _mm512_loadu_si512(src + 2*k);
+		const __m512i x1 = _mm512_loadu_si512(src + 2*k + 32);
+		_mm512_storeu_si512(even + k, _mm512_permutex2var_epi16(x0, evenIdx, x1));
+		_mm512_storeu_si512(odd + k, _mm512_permutex2var_epi16(x0, oddIdx, x1));
+	}
+	SplitAVX2(src + 2*k, even + k, odd + k, n - k);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void MergeAVX512(DataT* dest, const DataT* even, const DataT* odd, UINT32 n) {
+	const __m512i loIdx = _mm512_loadu_si512(MergeLoIdx);
+	const __m512i hiIdx = _mm512_loadu_si512(MergeHiIdx);
+	UINT32 k = 0;
+	for (; k + 32 <= n; k += 32) {
+		const __m512i e = _mm512_loadu_si512(even + k);
+		const __m512i o = _mm512_loadu_si512(odd + k);
+		_mm512_storeu_si512(dest + 2*k, _mm512_permutex2var_epi16(e, loIdx, o));
+		_mm512_storeu_si512(dest + 2*k + 32, _mm512_permutex2var_epi16(e, hiIdx, o));
+	}
+	MergeAVX2(dest + 2*k, even + k, odd + k, n - k);
+}
+#endif // PGF_SIMD_LIFTING && PGF_SIMD_AVX
+
+//////////////////////////////////////////////////////////////////////////
+// Selects the lifting kernels of the widest instruction set supported by the CPU.
+static LiftingKernels SelectLiftingKernels() {
+#if defined(PGF_SIMD_LIFTING) && defined(PGF_SIMD_AVX)
+	const SimdLevel level = SimdCpuLevel();
+	if (level == SimdAVX512) {
+		const LiftingKernels k = { PredictAVX512, UpdateAVX512, InversePredictAVX512, InverseUpdateAVX512, SplitAVX512, MergeAVX512 };
+		return k;
+	}
+	if (level == SimdAVX2) {
+		const LiftingKernels k = { PredictAVX2, UpdateAVX2, InversePredictAVX2, InverseUpdateAVX2, SplitAVX2, MergeAVX2 };
+		return k;
+	}
+#endif
+#ifdef PGF_SIMD_LIFTING
+	const LiftingKernels k = { PredictSimd, UpdateSimd, InversePredictSimd, InverseUpdateSimd, SplitSimd, MergeSimd };
+#else
+	const LiftingKernels k = { PredictScalar, UpdateScalar, InversePredictScalar, InverseUpdateScalar, nullptr, nullptr };
+#endif
+	return k;
+}
+
+static const LiftingKernels& Lifting() {
+	static const LiftingKernels kernels = SelectLiftingKernels(); // thread-safe initialization
+	return kernels;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Constructor: Constructs a wavelet transform pyramid of given size and levels.
 // @param width The width of the original image (at level 0) in pixels
@@ -40,6 +332,8 @@
 CWaveletTransform::CWaveletTransform(UINT32 width, UINT32 height, int levels, DataT* data)
 : m_nLevels(levels + 1) // m_nLevels in CPGFImage determines the number of FWT steps; this.m_nLevels determines the number subband-planes
 , m_subband(nullptr)
+, m_strip(nullptr)
+, m_stripQuant(0)
 #ifdef __PGFROISUPPORT__
 , m_indices(nullptr)
 #endif
@@ -84,6 +378,7 @@ void CWaveletTransform::InitSubbands(UINT32 width, UINT32 height, DataT* data) {
 // high pass filter at odd positions: 1/4[-2, (4), -2]
 // @param level A wavelet transform pyramid level (>= 0 && < Levels())
 // @param quant A quantization value (linear scalar quantization)
+// The subbands are quantized row by row in InterleavedToSubbands, while the rows are still in cache.
 // @return error in case of a memory allocation problem
 OSError CWaveletTransform::ForwardTransform(int level, int quant) {
 	ASSERT(level >= 0 && level < m_nLevels - 1);
@@ -94,91 +389,238 @@ OSError CWaveletTransform::ForwardTransform(int level, int quant) {
 	const UINT32 height = srcBand->GetHeight();
 	DataT* src = srcBand->GetBuffer(); ASSERT(src);
 	DataT *row0, *row1, *row2, *row3;
+	const LiftingKernels& lifting = Lifting();
 
 	// Allocate memory for next transform level
 	for (int i=0; i < NSubbands; i++) {
 		if (!m_subband[destLevel][i].AllocMemory()) return InsufficientMemory;
 	}
 
+	// row buffer for even and odd positions used in ForwardRow
+	DataT* rowBuffer = new(std::nothrow) DataT[width];
+	if (!rowBuffer) return InsufficientMemory;
+
  	if (height >= FilterSize) { // changed from FilterSizeH to FilterSize
 		// top border handling
 		row0 = src; row1 = row0 + width; row2 = row1 + width;
-		ForwardRow(row0, width);
-		ForwardRow(row1, width);
-		ForwardRow(row2, width);
-		for (UINT32 k=0; k < width; k++) {
-			row1[k] -= ((row0[k] + row2[k] + c1) >> 1); // high pass
-			row0[k] += ((row1[k] + c1) >> 1); // low pass
-		}
-		InterleavedToSubbands(destLevel, row0, row1, width);
+		ForwardRow(row0, width, rowBuffer);
+		ForwardRow(row1, width, rowBuffer);
+		ForwardRow(row2, width, rowBuffer);
+		lifting.Predict(row1, row0, row2, width); // high pass
+		lifting.Update(row0, row1, row1, width); // low pass: (2*row1 + c2) >> 2 == (row1 + c1) >> 1
+		InterleavedToSubbands(destLevel, row0, row1, width, quant);
 		row0 = row1; row1 = row2; row2 += width; row3 = row2 + width;
 
 		// middle part
 		for (UINT32 i=3; i < height-1; i += 2) {
-			ForwardRow(row2, width);
-			ForwardRow(row3, width);
-			for (UINT32 k=0; k < width; k++) {
-				row2[k] -= ((row1[k] + row3[k] + c1) >> 1); // high pass filter
-				row1[k] += ((row0[k] + row2[k] + c2) >> 2); // low pass filter
-			}
-			InterleavedToSubbands(destLevel, row1, row2, width);
+			ForwardRow(row2, width, rowBuffer);
+			ForwardRow(row3, width, rowBuffer);
+			lifting.Predict(row2, row1, row3, width); // high pass filter
+			lifting.Update(row1, row0, row2, width); // low pass filter
+			InterleavedToSubbands(destLevel, row1, row2, width, quant);
 			row0 = row2; row1 = row3; row2 = row3 + width; row3 = row2 + width;
 		}
 
 		// bottom border handling
 		if (height & 1) {
-			for (UINT32 k=0; k < width; k++) {
-				row1[k] += ((row0[k] + c1) >> 1); // low pass
-			}
-			InterleavedToSubbands(destLevel, row1, nullptr, width);
+			lifting.Update(row1, row0, row0, width); // low pass
+			InterleavedToSubbands(destLevel, row1, nullptr, width, quant);
 			row0 = row1; row1 += width;
 		} else {
-			ForwardRow(row2, width);
-			for (UINT32 k=0; k < width; k++) {
-				row2[k] -= row1[k]; // high pass
-				row1[k] += ((row0[k] + row2[k] + c2) >> 2); // low pass
-			}
-			InterleavedToSubbands(destLevel, row1, row2, width);
+			ForwardRow(row2, width, rowBuffer);
+			lifting.Predict(row2, row1, row1, width); // high pass: (2*row1 + c1) >> 1 == row1
+			lifting.Update(row1, row0, row2, width); // low pass
+			InterleavedToSubbands(destLevel, row1, row2, width, quant);
 			row0 = row1; row1 = row2; row2 += width;
 		}
 	} else {
 		// if height is too small
 		row0 = src; row1 = row0 + width;
 		// first part
-		for (UINT32 k=0; k < height; k += 2) {
-			ForwardRow(row0, width);
-			ForwardRow(row1, width);
-			InterleavedToSubbands(destLevel, row0, row1, width);
+		for (UINT32 k=1; k < height; k += 2) {
+			ForwardRow(row0, width, rowBuffer);
+			ForwardRow(row1, width, rowBuffer);
+			InterleavedToSubbands(destLevel, row0, row1, width, quant);
 			row0 += width << 1; row1 += width << 1;
 		}
 		// bottom
 		if (height & 1) {
-			InterleavedToSubbands(destLevel, row0, nullptr, width);
+			ForwardRow(row0, width, rowBuffer);
+			InterleavedToSubbands(destLevel, row0, nullptr, width, quant);
 		}
 	}
+	delete[] rowBuffer;
 
-	if (quant > 0) {
-		// subband quantization (without LL)
-		for (int i=1; i < NSubbands; i++) {
-			m_subband[destLevel][i].Quantize(quant);
-		}
-		// LL subband quantization
-		if (destLevel == m_nLevels - 1) {
-			m_subband[destLevel][LL].Quantize(quant);
+	// free source band
+	srcBand->FreeMemory();
+	return NoError;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Starts a strip-based forward transform of all levels.
+// Allocates the subbands HL, LH, HH of all levels, LL of the highest level,
+// and a lifting window of four rows per transformed level.
+// @param quant A quantization value (linear scalar quantization)
+// @return error in case of a memory allocation problem
+OSError CWaveletTransform::BeginForwardStrip(int quant) {
+	ASSERT(!m_strip);
+	ASSERT(!m_subband[0][LL].GetBuffer());
+	const int nLevels = m_nLevels - 1; // number of transformed levels
+
+	// Allocate memory of the subbands
+	if (!m_subband[nLevels][LL].AllocMemory()) return InsufficientMemory;
+	for (int level=1; level <= nLevels; level++) {
+		for (int i=HL; i < NSubbands; i++) {
+			if (!m_subband[level][i].AllocMemory()) return InsufficientMemory;
 		}
 	}
 
-	// free source band
-	srcBand->FreeMemory();
+	// Allocate lifting windows: 4 rows, ForwardRow buffer, and LL row
+	m_strip = new(std::nothrow) StripLevel[__max(nLevels, 1)];
+	if (!m_strip) return InsufficientMemory;
+	memset(m_strip, 0, __max(nLevels, 1)*sizeof(StripLevel));
+	for (int level=0; level < nLevels; level++) {
+		StripLevel& s = m_strip[level];
+		const UINT32 width = m_subband[level][LL].GetWidth();
+
+		s.rowMem = new(std::nothrow) DataT[6*width];
+		if (!s.rowMem) {
+			EndForwardStrip();
+			return InsufficientMemory;
+		}
+		for (int k=0; k < 4; k++) s.slot[k] = s.rowMem + k*width;
+		s.buffer = s.rowMem + 4*width;
+		s.llRow = s.rowMem + 5*width;
+	}
+	m_stripQuant = quant;
 	return NoError;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Transforms the next rows of the channel in a strip-based forward transform.
+// @param rows nRows consecutive rows of the width of the channel
+// @param nRows The number of rows
+void CWaveletTransform::ForwardStrip(const DataT* rows, UINT32 nRows) {
+	ASSERT(m_strip);
+	const UINT32 width = m_subband[0][LL].GetWidth();
+	const UINT32 height = m_subband[0][LL].GetHeight();
+
+	if (m_nLevels == 1) {
+		// no transform: the channel is subband LL of the highest level
+		CSubband& ll = m_subband[0][LL];
+		ASSERT(ll.GetBuffPos() + nRows*width <= (UINT32)ll.GetHeight()*width);
+		memcpy(ll.GetBuffer() + ll.GetBuffPos(), rows, nRows*width*DataTSize);
+		ll.SetBuffPos(ll.GetBuffPos() + nRows*width);
+		m_strip[0].nRows += nRows;
+	} else {
+		for (UINT32 i=0; i < nRows; i++) {
+			StripRow(0, rows);
+			rows += width;
+		}
+	}
+	ASSERT(m_strip[0].nRows <= height);
+	if (m_strip[0].nRows == height) EndForwardStrip();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Forward transform of the next row of subband LL at given level.
+// The vertical lifting steps are the same as in ForwardTransform: a high pass row
+// is filtered as soon as the following even row is available, and the low pass row
+// above it is filtered with the high pass rows above and below.
+// @param level A wavelet transform pyramid level (>= 0 && < Levels() - 1)
+// @param row A row of subband LL at given level
+void CWaveletTransform::StripRow(int level, const DataT* row) {
+	StripLevel& s = m_strip[level];
+	const UINT32 width = m_subband[level][LL].GetWidth();
+	const UINT32 height = m_subband[level][LL].GetHeight();
+	const LiftingKernels& lifting = Lifting();
+
+	// copy row into a free row buffer and transform it horizontally
+	int k = 0;
+	while (s.slot[k] == s.even || s.slot[k] == s.odd || s.slot[k] == s.high) k++;
+	DataT* cur = s.slot[k];
+	memcpy(cur, row, width*DataTSize);
+	ForwardRow(cur, width, s.buffer);
+
+	const UINT32 y = s.nRows++;
+	ASSERT(y < height);
+
+	if (height < FilterSize) {
+		// if height is too small: no vertical filtering
+		if (y & 1) {
+			StripToSubbands(level, s.even, cur);
+			s.even = nullptr;
+		} else if (y == height - 1) {
+			StripToSubbands(level, cur, nullptr);
+		} else {
+			s.even = cur;
+		}
+	} else if (y == 0) {
+		s.even = cur;
+	} else if (y & 1) {
+		s.odd = cur;
+		if (y == height - 1) {
+			// bottom border handling
+			lifting.Predict(s.odd, s.even, s.even, width); // high pass: (2*even + c1) >> 1 == even
+			lifting.Update(s.even, s.high, s.odd, width); // low pass
+			StripToSubbands(level, s.even, s.odd);
+		}
+	} else {
+		lifting.Predict(s.odd, s.even, cur, width); // high pass
+		if (s.high) {
+			lifting.Update(s.even, s.high, s.odd, width); // low pass
+		} else {
+			lifting.Update(s.even, s.odd, s.odd, width); // top border: (2*odd + c2) >> 2 == (odd + c1) >> 1
+		}
+		StripToSubbands(level, s.even, s.odd);
+		s.high = s.odd; s.odd = nullptr; s.even = cur;
+		if (y == height - 1) {
+			// bottom border handling
+			lifting.Update(s.even, s.high, s.high, width); // low pass
+			StripToSubbands(level, s.even, nullptr);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Stores transformed rows of given level in the subbands of the next level.
+// The LL row of an intermediate level is passed to the transform of the next level.
+void CWaveletTransform::StripToSubbands(int level, DataT* loRow, DataT* hiRow) {
+	const int destLevel = level + 1;
+	const UINT32 width = m_subband[level][LL].GetWidth();
+
+	if (destLevel == m_nLevels - 1) {
+		InterleavedToSubbands(destLevel, loRow, hiRow, width, m_stripQuant);
+	} else {
+		DataT* llRow = m_strip[level].llRow;
+		InterleavedToSubbands(destLevel, loRow, hiRow, width, m_stripQuant, llRow);
+		StripRow(destLevel, llRow);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Releases the lifting windows of a strip-based forward transform.
+void CWaveletTransform::EndForwardStrip() {
+	if (m_strip) {
+		for (int level=0; level < m_nLevels - 1; level++) {
+			delete[] m_strip[level].rowMem;
+		}
+		delete[] m_strip; m_strip = nullptr;
+	}
+}
+
 //////////////////////////////////////////////////////////////
 // Forward transform one row
 // low pass filter at even positions: 1/8[-1, 2, (6), 2, -1]
 // high pass filter at odd positions: 1/4[-2, (4), -2]
-void CWaveletTransform::ForwardRow(DataT* src, UINT32 width) {
-	if (width >= FilterSize) {
+// Vectorized: the row is split into even and odd positions, lifted, and merged again.
+// All high pass values depend on the original even values only, hence the
+// high pass can be computed for the whole row before the low pass.
+// @param buffer Temporary buffer of at least width values
+void CWaveletTransform::ForwardRow(DataT* src, UINT32 width, DataT* buffer) {
+	const LiftingKernels& lifting = Lifting();
+
+	if (width >= FilterSize && !lifting.Split) {
 		UINT32 i = 3;
 
 		// left border handling
@@ -198,34 +640,79 @@ void CWaveletTransform::ForwardRow(DataT* src, UINT32 width) {
 			src[i] -= src[i-1]; // high pass
 			src[i-1] += ((src[i-2] + src[i] + c2) >> 2); // low pass
 		}
+	} else if (width >= FilterSize) {
+		const UINT32 nOdd = width >> 1;
+		const UINT32 nEven = width - nOdd;
+		DataT* even = buffer;
+		DataT* odd = buffer + nEven;
+
+		lifting.Split(src, even, odd, nOdd);
+		if (width & 1) even[nOdd] = src[width - 1];
+
+		// high pass
+		lifting.Predict(odd, even, even + 1, nEven - 1);
+		if (!(width & 1)) odd[nOdd - 1] -= even[nOdd - 1]; // right border
+
+		// low pass
+		even[0] += ((odd[0] + c1) >> 1); // left border
+		lifting.Update(even + 1, odd, odd + 1, nOdd - 1);
+		if (width & 1) even[nOdd] += ((odd[nOdd - 1] + c1) >> 1); // right border
+
+		lifting.Merge(src, even, odd, nOdd);
+		if (width & 1) src[width - 1] = even[nOdd];
 	}
 }
 
 /////////////////////////////////////////////////////////////////
 // Copy transformed and interleaved (L,H,L,H,...) rows loRow and hiRow to subbands LL,HL,LH,HH
-void CWaveletTransform::InterleavedToSubbands(int destLevel, DataT* loRow, DataT* hiRow, UINT32 width) {
+// and quantize the copied values with the given quantization value (see CSubband::QuantizationShift),
+// while they are still in cache. The LL subband is only quantized at the highest level.
+// @param llRow If not nullptr, the LL values are copied to llRow instead of subband LL
+void CWaveletTransform::InterleavedToSubbands(int destLevel, DataT* loRow, DataT* hiRow, UINT32 width, int quant, DataT* llRow) {
 	const UINT32 wquot = width >> 1;
 	const bool wrem = (width & 1);
 	CSubband &ll = m_subband[destLevel][LL], &hl = m_subband[destLevel][HL];
 	CSubband &lh = m_subband[destLevel][LH], &hh = m_subband[destLevel][HH];
+	UINT32 pos[NSubbands];
+
+	for (int i=0; i < NSubbands; i++) pos[i] = m_subband[destLevel][i].GetBuffPos();
+
+	DataT* llDest = (llRow) ? llRow : ll.GetBuffer() + pos[LL];
+	DataT* hlDest = hl.GetBuffer() + pos[HL];
 
 	if (hiRow) {
+		DataT* lhDest = lh.GetBuffer() + pos[LH];
+		DataT* hhDest = hh.GetBuffer() + pos[HH];
+
 		for (UINT32 i=0; i < wquot; i++) {
-			ll.WriteBuffer(*loRow++);	// first access, than increment
-			hl.WriteBuffer(*loRow++);
-			lh.WriteBuffer(*hiRow++);	// first access, than increment
-			hh.WriteBuffer(*hiRow++);
+			*llDest++ = *loRow++;	// first access, than increment
+			*hlDest++ = *loRow++;
+			*lhDest++ = *hiRow++;	// first access, than increment
+			*hhDest++ = *hiRow++;
 		}
 		if (wrem) {
-			ll.WriteBuffer(*loRow);
-			lh.WriteBuffer(*hiRow);
+			*llDest = *loRow;
+			*lhDest = *hiRow;
 		}
+		lh.SetBuffPos(pos[LH] + wquot + wrem);
+		hh.SetBuffPos(pos[HH] + wquot);
 	} else {
 		for (UINT32 i=0; i < wquot; i++) {
-			ll.WriteBuffer(*loRow++);	// first access, than increment
-			hl.WriteBuffer(*loRow++);
+			*llDest++ = *loRow++;	// first access, than increment
+			*hlDest++ = *loRow++;
+		}
+		if (wrem) *llDest = *loRow;
+	}
+	if (!llRow) ll.SetBuffPos(pos[LL] + wquot + wrem);
+	hl.SetBuffPos(pos[HL] + wquot);
+
+	if (quant > 0) {
+		for (int i = (destLevel == m_nLevels - 1) ? LL : HL; i < NSubbands; i++) {
+			CSubband& band = m_subband[destLevel][i];
+			int threshold;
+			const int shift = band.QuantizationShift(quant, threshold);
+			if (shift >= 0 && band.GetBuffPos() > pos[i]) band.QuantizeRange(pos[i], band.GetBuffPos() - pos[i], shift, threshold);
 		}
-		if (wrem) ll.WriteBuffer(*loRow);
 	}
 }
 
@@ -234,10 +721,6 @@ union ptrunion {
 	DataT *d;
 };
 
-typedef int16_t vec_s16 __attribute__ ((vector_size (16)));
-typedef uint16_t vec_u16 __attribute__ ((vector_size (16)));
-typedef long long vec_s64 __attribute__ ((vector_size (16)));
-
 
 //////////////////////////////////////////////////////////////////////////
 // Compute fast inverse wavelet transform of all 4 subbands of given level and
@@ -262,6 +745,7 @@ OSError CWaveletTransform::InverseTransform(int srcLevel, UINT32* w, UINT32* h,
 	// allocate memory for the results of the inverse transform
 	if (!destBand->AllocMemory()) return InsufficientMemory;
 	DataT *origin = destBand->GetBuffer(), *row0, *row1, *row2, *row3;
+	const LiftingKernels& lifting = Lifting();
 
 #ifdef __PGFROISUPPORT__
 	PGFRect destROI = destBand->GetAlignedROI();
@@ -352,96 +836,59 @@ OSError CWaveletTransform::InverseTransform(int srcLevel, UINT32* w, UINT32* h,
 	}
 #endif
 
+	// row buffer for even and odd positions used in InverseRow
+	DataT* rowBuffer = new(std::nothrow) DataT[width];
+	if (!rowBuffer) return InsufficientMemory;
+
 	if (destHeight >= FilterSize) { // changed from FilterSizeH to FilterSize
 		// top border handling
 		row0 = origin; row1 = row0 + destWidth;
 		SubbandsToInterleaved(srcLevel, row0, row1, width);
-		for (UINT32 k = 0; k < width; k++) {
-			row0[k] -= ((row1[k] + c1) >> 1); // even
-		}
+		lifting.InverseUpdate(row0, row1, row1, width); // even: (2*row1 + c2) >> 2 == (row1 + c1) >> 1
 
 		// middle part
 		row2 = row1 + destWidth; row3 = row2 + destWidth;
 		for (UINT32 i = destROI.top + 2; i < destROI.bottom - 1; i += 2) {
 			SubbandsToInterleaved(srcLevel, row2, row3, width);
-
-			UINT32 k = 0;
-			if ((((uint64_t) row0) & 15) == 0 &&
-				(((uint64_t) row1) & 15) == 0 &&
-				(((uint64_t) row2) & 15) == 0 &&
-				(((uint64_t) row3) & 15) == 0) {
-
-				const vec_s16 vc1 = (vec_s16) {
-					c1, c1, c1, c1,
-					c1, c1, c1, c1
-				};
-				const vec_s16 vc2 = (vec_s16) {
-					c2, c2, c2, c2,
-					c2, c2, c2, c2
-				};
-
-				for (; k < width - 7; k += 8) {
-					vec_s16 r0 = *(vec_s16 *) &row0[k];
-					vec_s16 r1 = *(vec_s16 *) &row1[k];
-					vec_s16 r2 = *(vec_s16 *) &row2[k];
-					vec_s16 r3 = *(vec_s16 *) &row3[k];
-
-					r3 += vc2 + r1;
-					r3 = __builtin_ia32_psrawi128(r3, 2); // >>=2
-					r2 -= r3;
-					*(vec_s16 *) &row2[k] = r2;
-
-					r2 += vc1 + r0;
-					r2 = __builtin_ia32_psrawi128(r2, 1); // >>=1
-					r1 += r2;
-					*(vec_s16 *) &row1[k] = r1;
-				}
-			}
-
-			for (; k < width; k++) {
-				row2[k] -= ((row1[k] + row3[k] + c2) >> 2); // even
-				row1[k] += ((row0[k] + row2[k] + c1) >> 1); // odd
-			}
-			InverseRow(row0, width);
-			InverseRow(row1, width);
+			lifting.InverseUpdate(row2, row1, row3, width); // even
+			lifting.InversePredict(row1, row0, row2, width); // odd
+			InverseRow(row0, width, rowBuffer);
+			InverseRow(row1, width, rowBuffer);
 			row0 = row2; row1 = row3; row2 = row1 + destWidth; row3 = row2 + destWidth;
 		}
 
 		// bottom border handling
 		if (height & 1) {
 			SubbandsToInterleaved(srcLevel, row2, nullptr, width);
-			for (UINT32 k = 0; k < width; k++) {
-				row2[k] -= ((row1[k] + c1) >> 1); // even
-				row1[k] += ((row0[k] + row2[k] + c1) >> 1); // odd
-			}
-			InverseRow(row0, width);
-			InverseRow(row1, width);
-			InverseRow(row2, width);
+			lifting.InverseUpdate(row2, row1, row1, width); // even
+			lifting.InversePredict(row1, row0, row2, width); // odd
+			InverseRow(row0, width, rowBuffer);
+			InverseRow(row1, width, rowBuffer);
+			InverseRow(row2, width, rowBuffer);
 			row0 = row1; row1 = row2; row2 += destWidth;
 		} else {
-			for (UINT32 k = 0; k < width; k++) {
-				row1[k] += row0[k];
-			}
-			InverseRow(row0, width);
-			InverseRow(row1, width);
+			lifting.InversePredict(row1, row0, row0, width); // odd: (2*row0 + c1) >> 1 == row0
+			InverseRow(row0, width, rowBuffer);
+			InverseRow(row1, width, rowBuffer);
 			row0 = row1; row1 += destWidth;
 		}
 	} else {
 		// height is too small
 		row0 = origin; row1 = row0 + destWidth;
 		// first part
-		for (UINT32 k = 0; k < height; k += 2) {
+		for (UINT32 k = 1; k < height; k += 2) {
 			SubbandsToInterleaved(srcLevel, row0, row1, width);
-			InverseRow(row0, width);
-			InverseRow(row1, width);
+			InverseRow(row0, width, rowBuffer);
+			InverseRow(row1, width, rowBuffer);
 			row0 += destWidth << 1; row1 += destWidth << 1;
 		}
 		// bottom
 		if (height & 1) {
 			SubbandsToInterleaved(srcLevel, row0, nullptr, width);
-			InverseRow(row0, width);
+			InverseRow(row0, width, rowBuffer);
 		}
 	}
+	delete[] rowBuffer;
 
 	// free memory of the current srcLevel
 	for (int i = 0; i < NSubbands; i++) {
@@ -460,68 +907,18 @@ OSError CWaveletTransform::InverseTransform(int srcLevel, UINT32* w, UINT32* h,
 // low-pass coefficients at even positions, high-pass coefficients at odd positions
 // inverse filter for even positions: 1/4[-1, (4), -1]
 // inverse filter for odd positions: 1/8[-1, 4, (6), 4, -1]
-void CWaveletTransform::InverseRow(DataT* dest, UINT32 width) {
-	if (width >= FilterSize) {
+// Vectorized: the row is split into even and odd positions, lifted, and merged again.
+// All even values depend on the original odd values only, hence the even positions
+// can be computed for the whole row before the odd positions.
+// @param buffer Temporary buffer of at least width values
+void CWaveletTransform::InverseRow(DataT* dest, UINT32 width, DataT* buffer) {
+	const LiftingKernels& lifting = Lifting();
+
+	if (width >= FilterSize && !lifting.Split) {
 		UINT32 i = 2;
 
-		if ((((uint64_t) dest) & 15) == 0) {
-
-			const vec_s16 vc1 = (vec_s16) {
-				c1, c1, c1, c1,
-				c1, c1, c1, c1
-			};
-			const vec_s16 vc2 = (vec_s16) {
-				c2, c2, c2, c2,
-				c2, c2, c2, c2
-			};
-			const vec_s16 evens = (vec_s16) (vec_u16) {
-				0xffff, 0, 0xffff, 0,
-				0xffff, 0, 0xffff, 0,
-			};
-			vec_s16 previn = (vec_s16) { 0, dest[1], };
-
-			for (i = 0; i < width - 7; i += 8) {
-				vec_s16 in = *(vec_s16 *) &dest[i];
-				// shift the entire reg by 32
-				vec_s16 tmp = (vec_s16) __builtin_ia32_pslldqi128((vec_s64) in, 32);
-
-				tmp += previn + in + vc2;
-				tmp = __builtin_ia32_psrawi128(tmp, 2);
-				// 1, 3, 5, 7 are now added and shifted
-				tmp = (vec_s16) __builtin_ia32_psrldqi128((vec_s64) tmp, 16);
-				tmp &= evens;
-				in -= tmp;
-
-				// store the current 7 as 1 for next gen
-				previn = (vec_s16) __builtin_ia32_psrldqi128((vec_s64) in, 96);
-
-				// Evens have now been processed with unprocessed odds
-				// Odds are yet untouched, they will use processed evens
-
-				tmp = (vec_s16) __builtin_ia32_pslldqi128((vec_s64) in, 32);
-				tmp += in + vc1;
-				tmp = __builtin_ia32_psrawi128(tmp, 1);
-				// 2, 4, 6 are now added and shifted for 1,3,5 odds
-				tmp &= evens;
-				tmp = (vec_s16) __builtin_ia32_psrldqi128((vec_s64) tmp, 16);
-				in += tmp;
-
-				*(vec_s16 *) &dest[i] = in;
-				/*
-				dest[i] -= ((dest[i-1] + dest[i+1] + c2) >> 2); // even
-				dest[i-1] += ((dest[i-2] + dest[i] + c1) >> 1); // odd
-				*/
-
-				// Scalarly handle the previous 7 since it depends
-				// on the current 0
-				if (i) {
-					dest[i-1] += ((dest[i-2] + dest[i] + c1) >> 1); // odd
-				}
-			}
-		} else {
-			// left border handling
-			dest[0] -= ((dest[1] + c1) >> 1); // even
-		}
+		// left border handling
+		dest[0] -= ((dest[1] + c1) >> 1); // even
 
 		// middle part
 		for (; i < width - 1; i += 2) {
@@ -536,6 +933,26 @@ void CWaveletTransform::InverseRow(DataT* dest, UINT32 width) {
 		} else {
 			dest[i-1] += dest[i-2]; // odd
 		}
+	} else if (width >= FilterSize) {
+		const UINT32 nOdd = width >> 1;
+		const UINT32 nEven = width - nOdd;
+		DataT* even = buffer;
+		DataT* odd = buffer + nEven;
+
+		lifting.Split(dest, even, odd, nOdd);
+		if (width & 1) even[nOdd] = dest[width - 1];
+
+		// even positions
+		even[0] -= ((odd[0] + c1) >> 1); // left border
+		lifting.InverseUpdate(even + 1, odd, odd + 1, nOdd - 1);
+		if (width & 1) even[nOdd] -= ((odd[nOdd - 1] + c1) >> 1); // right border
+
+		// odd positions
+		lifting.InversePredict(odd, even, even + 1, nEven - 1);
+		if (!(width & 1)) odd[nOdd - 1] += even[nOdd - 1]; // right border
+
+		lifting.Merge(dest, even, odd, nOdd);
+		if (width & 1) dest[width - 1] = even[nOdd];
 	}
 }
 
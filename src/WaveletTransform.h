@@ -76,6 +76,25 @@ public:
 	/// @return error in case of a memory allocation problem
 	OSError ForwardTransform(int level, int quant);
 
+	//////////////////////////////////////////////////////////////////////
+	/// Starts a strip-based forward wavelet transform of all levels.
+	/// In contrast to ForwardTransform, memory is bounded by the subbands to encode: the rows of the
+	/// channel are passed in top-down order with ForwardStrip, and each level keeps only the few rows
+	/// needed by the lifting filters. Neither the channel (subband LL at level 0) nor the LL subbands
+	/// of intermediate levels are allocated. Construct this transform without input data.
+	/// The result is identical to ForwardTransform of all levels.
+	/// @param quant A quantization value (linear scalar quantization)
+	/// @return error in case of a memory allocation problem
+	OSError BeginForwardStrip(int quant);
+
+	//////////////////////////////////////////////////////////////////////
+	/// Transforms the next rows of the channel (see BeginForwardStrip).
+	/// Subband rows are stored as soon as they are final. The call passing the last row
+	/// of the channel completes the transform and releases the strip buffers.
+	/// @param rows nRows consecutive rows of the width of the channel
+	/// @param nRows The number of rows
+	void ForwardStrip(const DataT* rows, UINT32 nRows);
+
 	//////////////////////////////////////////////////////////////////////
 	/// Compute fast inverse wavelet transform of all 4 subbands of given level and
 	/// stores result in LL subband of level - 1.
@@ -122,16 +141,33 @@ public:
 #endif // __PGFROISUPPORT__
 
 private:
+	//////////////////////////////////////////////////////////////////////
+	/// Rows of one level kept by a strip-based forward transform.
+	struct StripLevel {
+		DataT *rowMem;							///< memory of all rows of this level
+		DataT *slot[4];							///< row buffers of the lifting window
+		DataT *even;							///< even row, waiting for the low pass filter
+		DataT *odd;								///< odd row, waiting for the high pass filter
+		DataT *high;							///< previous high pass row, already stored in the subbands
+		DataT *buffer;							///< temporary buffer used in ForwardRow
+		DataT *llRow;							///< LL row passed to the next level
+		UINT32 nRows;							///< number of rows received
+	};
+
 	void Destroy() {
+		EndForwardStrip();
 		delete[] m_subband; m_subband = nullptr;
 	#ifdef __PGFROISUPPORT__
 		delete[] m_indices; m_indices = nullptr;
 	#endif
 	}
 	void InitSubbands(UINT32 width, UINT32 height, DataT* data);
-	void ForwardRow(DataT* buff, UINT32 width);
-	void InverseRow(DataT* buff, UINT32 width);
-	void InterleavedToSubbands(int destLevel, DataT* loRow, DataT* hiRow, UINT32 width);
+	void ForwardRow(DataT* buff, UINT32 width, DataT* buffer);
+	void InverseRow(DataT* buff, UINT32 width, DataT* buffer);
+	void InterleavedToSubbands(int destLevel, DataT* loRow, DataT* hiRow, UINT32 width, int quant, DataT* llRow = nullptr);
+	void StripRow(int level, const DataT* row);
+	void StripToSubbands(int level, DataT* loRow, DataT* hiRow);
+	void EndForwardStrip();
 	void SubbandsToInterleaved(int srcLevel, DataT* loRow, DataT* hiRow, UINT32 width);
 
 #ifdef __PGFROISUPPORT__
@@ -140,6 +176,8 @@ private:
 
 	int			m_nLevels;						///< number of LL levels: one more than header.nLevels in PGFimage
 	CSubband	(*m_subband)[NSubbands];		///< quadtree of subbands: LL HL LH HH
+	StripLevel	*m_strip;						///< strip-based forward transform: rows of levels [0, m_nLevels - 1) or nullptr
+	int			m_stripQuant;					///< strip-based forward transform: quantization value
 };
 
 #endif //PGF_WAVELETTRANSFORM_H
@@ -21,18 +21,21 @@ static uint8_t neededbits(uint8_t val) {
 	return bits;
 }
 
-static u8 patchvals[256];
-static u8 vals[16];
-static u8 numpatches, numvals;
-static u16 cumpatches;
-static u8 valmap[256];
-
 struct patch_t {
 	u16 pos;
 	u8 val;
 };
 
-static struct patch_t patches[32768];
+// Compressor state, kept on the stack of bitpack_comp
+struct bpstate_t {
+	u8 patchvals[256];
+	u8 vals[16];
+	u8 numpatches, numvals;
+	u16 cumpatches;
+	u8 valmap[256];
+
+	struct patch_t *patches;	// allocated by bitpack_comp
+};
 
 static int patchcmp(const void *ap, const void *bp) {
 	const struct patch_t *a = (struct patch_t *) ap;
@@ -51,16 +54,16 @@ static int patchcmp(const void *ap, const void *bp) {
 	return 0;
 }
 
-static void writepatches(u16 curpatch, const u16 counts[], u8 *patchstart) {
-	qsort(patches, curpatch, sizeof(struct patch_t),
+static void writepatches(struct bpstate_t *bs, u16 curpatch, const u16 counts[], u8 *patchstart) {
+	qsort(bs->patches, curpatch, sizeof(struct patch_t),
 		patchcmp);
 
-	if (curpatch != cumpatches) abort();
+	if (curpatch != bs->cumpatches) abort();
 
 	u16 p, i;
 	curpatch = 0;
-	for (p = 0; p < numpatches; p++) {
-		const u16 curval = patches[curpatch].val;
+	for (p = 0; p < bs->numpatches; p++) {
+		const u16 curval = bs->patches[curpatch].val;
 		const u16 curmax = counts[curval];
 
 		*patchstart++ = curval;
@@ -68,13 +71,13 @@ static void writepatches(u16 curpatch, const u16 counts[], u8 *patchstart) {
 
 		for (i = 0; i < curmax; i++, curpatch++) {
 			// BE pos of this patch
-			*patchstart++ = patches[curpatch].pos >> 8;
-			*patchstart++ = patches[curpatch].pos & 0xff;
+			*patchstart++ = bs->patches[curpatch].pos >> 8;
+			*patchstart++ = bs->patches[curpatch].pos & 0xff;
 		}
 	}
 }
 
-static u16 bitpack_comp4(const u8 *in, u8 *out, const u16 len,
+static u16 bitpack_comp4(struct bpstate_t *bs, const u8 *in, u8 *out, const u16 len,
 				const u8 patching, const u16 counts[]) {
 
 	//printf("4-bit compression\n");
@@ -86,15 +89,15 @@ static u16 bitpack_comp4(const u8 *in, u8 *out, const u16 len,
 	u16 i;
 	u16 curpatch = 0;
 
-	*out++ = numvals;
-	for (i = 0; i < numvals; i++)
-		*out++ = vals[i];
+	*out++ = bs->numvals;
+	for (i = 0; i < bs->numvals; i++)
+		*out++ = bs->vals[i];
 
-	*out++ = numpatches;
+	*out++ = bs->numpatches;
 
 	u8 *patchstart = out;
 	if (patching) {
-		out += numpatches * 2 + cumpatches * 2;
+		out += bs->numpatches * 2 + bs->cumpatches * 2;
 		//printf("Patches took %lu bytes\n", out - patchstart);
 	}
 
@@ -102,22 +105,22 @@ static u16 bitpack_comp4(const u8 *in, u8 *out, const u16 len,
 		const u8 a = *in++;
 		const u8 b = *in++;
 
-		u8 amap = valmap[a];
-		u8 bmap = valmap[b];
+		u8 amap = bs->valmap[a];
+		u8 bmap = bs->valmap[b];
 
 		if (patching) {
-			if (amap >= numvals) {
+			if (amap >= bs->numvals) {
 				amap = 0;
 
-				patches[curpatch].pos = i;
-				patches[curpatch].val = a;
+				bs->patches[curpatch].pos = i;
+				bs->patches[curpatch].val = a;
 				curpatch++;
 			}
-			if (bmap >= numvals) {
+			if (bmap >= bs->numvals) {
 				bmap = 0;
 
-				patches[curpatch].pos = i + 1;
-				patches[curpatch].val = b;
+				bs->patches[curpatch].pos = i + 1;
+				bs->patches[curpatch].val = b;
 				curpatch++;
 			}
 		}
@@ -126,7 +129,7 @@ static u16 bitpack_comp4(const u8 *in, u8 *out, const u16 len,
 	}
 
 	if (patching) {
-		writepatches(curpatch, counts, patchstart);
+		writepatches(bs, curpatch, counts, patchstart);
 	}
 
 	//printf("Compressed %u to %lu\n", len, out - origout);
@@ -134,7 +137,7 @@ static u16 bitpack_comp4(const u8 *in, u8 *out, const u16 len,
 	return out - origout;
 }
 
-static u16 bitpack_comp3(const u8 *in, u8 *out, const u16 len,
+static u16 bitpack_comp3(struct bpstate_t *bs, const u8 *in, u8 *out, const u16 len,
 				const u8 patching, const u16 counts[]) {
 
 	//printf("3-bit compression\n");
@@ -146,15 +149,15 @@ static u16 bitpack_comp3(const u8 *in, u8 *out, const u16 len,
 	u16 i;
 	u16 curpatch = 0;
 
-	*out++ = numvals;
-	for (i = 0; i < numvals; i++)
-		*out++ = vals[i];
+	*out++ = bs->numvals;
+	for (i = 0; i < bs->numvals; i++)
+		*out++ = bs->vals[i];
 
-	*out++ = numpatches;
+	*out++ = bs->numpatches;
 
 	u8 *patchstart = out;
 	if (patching) {
-		out += numpatches * 2 + cumpatches * 2;
+		out += bs->numpatches * 2 + bs->cumpatches * 2;
 		//printf("Patches took %lu bytes\n", out - patchstart);
 	}
 
@@ -162,16 +165,16 @@ static u16 bitpack_comp3(const u8 *in, u8 *out, const u16 len,
 		u8 reads[8], rmap[8], r;
 		for (r = 0; r < 8; r++) {
 			reads[r] = *in++;
-			rmap[r] = valmap[reads[r]];
+			rmap[r] = bs->valmap[reads[r]];
 		}
 
 		if (patching) {
 			for (r = 0; r < 8; r++) {
-				if (rmap[r] >= numvals) {
+				if (rmap[r] >= bs->numvals) {
 					rmap[r] = 0;
 
-					patches[curpatch].pos = i + r;
-					patches[curpatch].val = reads[r];
+					bs->patches[curpatch].pos = i + r;
+					bs->patches[curpatch].val = reads[r];
 					curpatch++;
 				}
 			}
@@ -193,7 +196,7 @@ static u16 bitpack_comp3(const u8 *in, u8 *out, const u16 len,
 	}
 
 	if (patching) {
-		writepatches(curpatch, counts, patchstart);
+		writepatches(bs, curpatch, counts, patchstart);
 	}
 
 	//printf("Compressed %u to %lu\n", len, out - origout);
@@ -234,38 +237,52 @@ u16 bitpack_comp(const u8 *in, u8 *out, const u16 len) {
 	//printf("used %u, patchused %u, bits %u %u, patching %u\n",
 	//	used, patchused, usedbits, patchedbits, patching);
 
-	numpatches = numvals = cumpatches = 0;
+	struct bpstate_t state, * const bs = &state;
+	u16 res;
+
+	bs->numpatches = bs->numvals = bs->cumpatches = 0;
 
-	memset(valmap, 0xff, 256);
+	memset(bs->valmap, 0xff, 256);
 
 	if (patching) {
 		for (i = 0; i < 256; i++) {
 			if (!counts[i])
 				continue;
 			if (counts[i] < limit) {
-				patchvals[numpatches] = i;
-				numpatches++;
-				cumpatches += counts[i];
+				bs->patchvals[bs->numpatches] = i;
+				bs->numpatches++;
+				bs->cumpatches += counts[i];
 			} else {
-				vals[numvals] = i;
-				valmap[i] = numvals;
-				numvals++;
+				bs->vals[bs->numvals] = i;
+				bs->valmap[i] = bs->numvals;
+				bs->numvals++;
 			}
 		}
 	} else {
 		for (i = 0; i < 256; i++) {
 			if (!counts[i])
 				continue;
-			vals[numvals] = i;
-			valmap[i] = numvals;
-			numvals++;
+			bs->vals[bs->numvals] = i;
+			bs->valmap[i] = bs->numvals;
+			bs->numvals++;
 		}
 	}
 
-	if (numvals > 8)
-		return bitpack_comp4(in, out, len, patching, counts);
+	// the patch list can take up to len entries, so it lives on the heap
+	bs->patches = NULL;
+	if (patching) {
+		bs->patches = (struct patch_t *) malloc((bs->cumpatches + 1) * sizeof(struct patch_t));
+		if (!bs->patches)
+			return USHRT_MAX;
+	}
+
+	if (bs->numvals > 8)
+		res = bitpack_comp4(bs, in, out, len, patching, counts);
 	else
-		return bitpack_comp3(in, out, len, patching, counts);
+		res = bitpack_comp3(bs, in, out, len, patching, counts);
+
+	free(bs->patches);
+	return res;
 }
 
 void bitpack_decomp(const u8 *in, u8 *out, const u16 outlen) {
@@ -573,18 +573,21 @@ void build_prefix_codes(Fsym *input,int num)
 	}
 }
 
-U8 *byte_pos,*init_pos,*byte_end,c;
-U32 nibble_count;
+struct nibstate_t {
+	U8 *byte_pos,*init_pos,*byte_end,c;
+	U32 nibble_count;
+};
 
-INLINE void init_nibble(U8 *pos,U8 *end)
+INLINE void init_nibble(struct nibstate_t *ns,U8 *pos,U8 *end)
 {
-	byte_pos = pos;
-	init_pos = pos;
-	byte_end = end;
-	nibble_count = 0;
+	ns->byte_pos = pos;
+	ns->init_pos = pos;
+	ns->byte_end = end;
+	ns->nibble_count = 0;
+	ns->c = 0;
 }
 
-INLINE U8 get_nibble()
+INLINE U8 get_nibble(struct nibstate_t *ns)
 {
 	//branchless
 	/*byte_pos += nibble_count%2;
@@ -592,44 +595,45 @@ INLINE U8 get_nibble()
 	nibble_count++;
 	return res;*/
 	//with branch
-	if(nibble_count++%2 == 0){
-		CHECK(byte_pos >= byte_end)
+	if(ns->nibble_count++%2 == 0){
+		CHECK(ns->byte_pos >= ns->byte_end)
 			return 100;
-		c = *byte_pos++;
-		return c & 15;
+		ns->c = *ns->byte_pos++;
+		return ns->c & 15;
 	}else{
-		return c >> 4;
+		return ns->c >> 4;
 	}
 }
 
-INLINE void put_nibble(U8 n)
+INLINE void put_nibble(struct nibstate_t *ns,U8 n)
 {
-	if(nibble_count++%2 == 0){
-		c = n;
+	if(ns->nibble_count++%2 == 0){
+		ns->c = n;
 	}else{
-		c |= n << 4;
-		*byte_pos++ = (U8)c;
+		ns->c |= n << 4;
+		*ns->byte_pos++ = (U8)ns->c;
 	}
 }
 
 //returns number of bytes writen
-INLINE U32 flush_nibbles()
+INLINE U32 flush_nibbles(struct nibstate_t *ns)
 {
-	if(nibble_count%2 == 1)
-		*byte_pos++ = c;
-	return byte_pos - init_pos;
+	if(ns->nibble_count%2 == 1)
+		*ns->byte_pos++ = ns->c;
+	return ns->byte_pos - ns->init_pos;
 }
 
-INLINE U32 get_input_nibbles()
+INLINE U32 get_input_nibbles(struct nibstate_t *ns)
 {
-	return byte_pos - init_pos;
+	return ns->byte_pos - ns->init_pos;
 }
 
 //return bytes written
 U32 write_prefix_descr(Enode *lookup,U8 *res,int sym_num)
 {
 	U32 previous,count,a;
-	init_nibble(res,0);
+	struct nibstate_t ns;
+	init_nibble(&ns,res,0);
 	for(a = 0;a < sym_num;a++){
 		count = 1;
 		previous = lookup[a].len;
@@ -638,38 +642,39 @@ U32 write_prefix_descr(Enode *lookup,U8 *res,int sym_num)
 			count++,a++;
 
 		if(count == 1){
-			put_nibble(previous);
+			put_nibble(&ns,previous);
 		}else if(count == 2){
-			put_nibble(previous);
-			put_nibble(previous);
+			put_nibble(&ns,previous);
+			put_nibble(&ns,previous);
 		}else{
 			if(previous == 0 && count == a+1)
 				count++;
 			else
-				put_nibble(previous);
+				put_nibble(&ns,previous);
 			if(count <= 16-MAX_BIT_LEN)
-				put_nibble(MAX_BIT_LEN+count-2);
+				put_nibble(&ns,MAX_BIT_LEN+count-2);
 			else{
-				put_nibble(15);
+				put_nibble(&ns,15);
 				count -= 17-MAX_BIT_LEN;
 				while(count >= 15){
-					put_nibble(15);
+					put_nibble(&ns,15);
 					count -= 15;
 				}
-				put_nibble(count);
+				put_nibble(&ns,count);
 			}
 		}
 	}
-	return flush_nibbles();
+	return flush_nibbles(&ns);
 }
 
 //on error return 0
 U32 read_prefix_descr(U8 *len,U8 *in,U8 *end,int sym_num)
 {
 	int bl,previous = 0,a = 0,c;
-	init_nibble(in,end);
+	struct nibstate_t ns;
+	init_nibble(&ns,in,end);
 	while(a < sym_num){
-		bl = get_nibble();
+		bl = get_nibble(&ns);
 		CHECK(bl == 100)
 			return 0;
 		if(bl <= MAX_BIT_LEN){
@@ -688,7 +693,7 @@ U32 read_prefix_descr(U8 *len,U8 *in,U8 *end,int sym_num)
 			while(c-- > 0)
 				len[a++] = previous;
 			do{
-				c = bl = get_nibble();
+				c = bl = get_nibble(&ns);
 				CHECK(c == 100 || a + c > sym_num)
 					return 0;
 				while(c-->0)
@@ -696,7 +701,7 @@ U32 read_prefix_descr(U8 *len,U8 *in,U8 *end,int sym_num)
 			}while(bl == 15);
 		}
 	}
-	return get_input_nibbles();
+	return get_input_nibbles(&ns);
 }
 
 INLINE void write_header(U16 *pos,U32 *stream_size)
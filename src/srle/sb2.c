@@ -17,82 +17,86 @@ static uint8_t neededbits(uint8_t val) {
 	return bits;
 }
 
-static uint8_t store;
-static uint8_t storedbits;
-static uint8_t *bitout, *bitstart;
-static const uint8_t *bitin;
-
-static void bit_init_write(uint8_t *ptr) {
-	store = 0;
-	storedbits = 0;
-	bitstart = bitout = ptr;
+// Bit I/O state. It lives on the stack of the calling codec function,
+// so that several blocks can be (de)compressed in parallel.
+struct bitstate_t {
+	uint8_t store;
+	uint8_t storedbits;
+	uint8_t *bitout, *bitstart;
+	const uint8_t *bitin;
+};
+
+static void bit_init_write(struct bitstate_t *bs, uint8_t *ptr) {
+	bs->store = 0;
+	bs->storedbits = 0;
+	bs->bitstart = bs->bitout = ptr;
 }
 
-static void bit_init_read(const uint8_t *ptr) {
-	store = 0;
-	storedbits = 0;
-	bitin = ptr;
+static void bit_init_read(struct bitstate_t *bs, const uint8_t *ptr) {
+	bs->store = 0;
+	bs->storedbits = 0;
+	bs->bitin = ptr;
 }
 
-static uint16_t bit_flush() {
-	if (storedbits) {
-		*bitout++ = store >> (8 - storedbits);
-		storedbits = 0;
-		store = 0;
+static uint16_t bit_flush(struct bitstate_t *bs) {
+	if (bs->storedbits) {
+		*bs->bitout++ = bs->store >> (8 - bs->storedbits);
+		bs->storedbits = 0;
+		bs->store = 0;
 	}
 
-	return bitout - bitstart;
+	return bs->bitout - bs->bitstart;
 }
 
-static void bit_write(uint8_t val, uint8_t num) {
-	if (!storedbits && num == 8) {
-		*bitout++ = val;
+static void bit_write(struct bitstate_t *bs, uint8_t val, uint8_t num) {
+	if (!bs->storedbits && num == 8) {
+		*bs->bitout++ = val;
 		return;
 	}
 
 	while (num) {
-		store >>= 1;
-		store |= (val & 1) << 7;
+		bs->store >>= 1;
+		bs->store |= (val & 1) << 7;
 		val >>= 1;
 		num--;
-		storedbits++;
+		bs->storedbits++;
 
-		if (storedbits == 8) {
-			bit_flush();
+		if (bs->storedbits == 8) {
+			bit_flush(bs);
 		}
 	}
 }
 
-static uint8_t bit_read(uint8_t num) {
+static uint8_t bit_read(struct bitstate_t *bs, uint8_t num) {
 	uint8_t val = 0;
 
-	if (!storedbits) {
-		store = *bitin++;
-		storedbits = 8;
+	if (!bs->storedbits) {
+		bs->store = *bs->bitin++;
+		bs->storedbits = 8;
 	}
 
-	if (num == storedbits) {
-		storedbits = 0;
-		return store;
-	} else if (num < storedbits) {
-		val = store & ((1 << num) - 1);
-		storedbits -= num;
-		store >>= num;
+	if (num == bs->storedbits) {
+		bs->storedbits = 0;
+		return bs->store;
+	} else if (num < bs->storedbits) {
+		val = bs->store & ((1 << num) - 1);
+		bs->storedbits -= num;
+		bs->store >>= num;
 		return val;
 	} else {
 		const uint8_t num_mask = ((1 << num) - 1);
-		val = store;
-		num -= storedbits;
-		const uint8_t got = storedbits;
+		val = bs->store;
+		num -= bs->storedbits;
+		const uint8_t got = bs->storedbits;
 
-		store = *bitin++;
-		storedbits = 8;
+		bs->store = *bs->bitin++;
+		bs->storedbits = 8;
 
-		val |= store << got;
+		val |= bs->store << got;
 		val &= num_mask;
 
-		store >>= num;
-		storedbits -= num;
+		bs->store >>= num;
+		bs->storedbits -= num;
 		return val;
 	}
 }
@@ -102,6 +106,7 @@ uint16_t sb2_comp(const uint8_t *in, uint8_t *out, const uint16_t len) {
 	uint16_t bytes[256] = { 0 }, i, used;
 	uint8_t chr2pos[256] = { 0 };
 	uint8_t * const start = out;
+	struct bitstate_t bs;
 
 	if (len > 16384)
 		return USHRT_MAX;
@@ -130,14 +135,14 @@ uint16_t sb2_comp(const uint8_t *in, uint8_t *out, const uint16_t len) {
 			*out++ = i;
 		}
 	}
-	bit_init_write(out);
+	bit_init_write(&bs, out);
 
 	const uint8_t bitlen = neededbits(used - 1);
 
 	for (i = 0; i < len; ) {
 		const uint8_t cur = in[i];
 		if (cur) {
-			bit_write(chr2pos[cur], bitlen);
+			bit_write(&bs, chr2pos[cur], bitlen);
 			i++;
 		} else {
 			// How many zeros?
@@ -151,31 +156,31 @@ uint16_t sb2_comp(const uint8_t *in, uint8_t *out, const uint16_t len) {
 			i += end;
 
 			do {
-				bit_write(0, bitlen);
+				bit_write(&bs, 0, bitlen);
 				end--;
 				if (end < 32) {
-					bit_write(end, 6);
+					bit_write(&bs, end, 6);
 					end = 0;
 				} else if (end < 2047) {
 					const uint8_t val = (end & 31) | 32;
-					bit_write(val, 6);
-					bit_write(end >> 5, 6);
+					bit_write(&bs, val, 6);
+					bit_write(&bs, end >> 5, 6);
 					end = 0;
 				} else if (end == 2047) {
 					// Special-case the edge case, split to 2046 + 1
 					const uint8_t val = (2046 & 31) | 32;
-					bit_write(val, 6);
-					bit_write(2046 >> 5, 6);
+					bit_write(&bs, val, 6);
+					bit_write(&bs, 2046 >> 5, 6);
 
-					bit_write(0, bitlen);
-					bit_write(0, 6);
+					bit_write(&bs, 0, bitlen);
+					bit_write(&bs, 0, 6);
 
 					end = 0;
 				} else {
 					// For very long zero runs, output a long run and repeat
 					const uint8_t val = (2047 & 31) | 32;
-					bit_write(val, 6);
-					bit_write(2047 >> 5, 6);
+					bit_write(&bs, val, 6);
+					bit_write(&bs, 2047 >> 5, 6);
 					end -= 2047;
 				}
 			} while (end);
@@ -183,7 +188,7 @@ uint16_t sb2_comp(const uint8_t *in, uint8_t *out, const uint16_t len) {
 	}
 	if (i != len) abort();
 
-	out += bit_flush();
+	out += bit_flush(&bs);
 
 	return out - start;
 }
@@ -191,25 +196,26 @@ uint16_t sb2_comp(const uint8_t *in, uint8_t *out, const uint16_t len) {
 void sb2_decomp(const uint8_t *in, uint8_t *out, const uint16_t outlen) {
 //uint8_t * const outstart = out;
 	const uint8_t * const end = out + outlen;
+	struct bitstate_t bs;
 	const uint8_t numvals = *in++;
 	const uint8_t * const valtab = in;
 	in += numvals;
 
 	const uint8_t bitlen = neededbits(numvals - 1);
 
-	bit_init_read(in);
+	bit_init_read(&bs, in);
 
 	while (out < end) {
-		uint8_t val = bit_read(bitlen);
+		uint8_t val = bit_read(&bs, bitlen);
 
 		*out++ = valtab[val];
 		if (!val) { // zero rle?
 			uint16_t len;
-			len = bit_read(6);
+			len = bit_read(&bs, 6);
 			//printf("read %u (6 bits)\n", len);
 			if (len & (1 << 5)) {
 				len &= ~(1 << 5);
-				len |= bit_read(6) << 5;
+				len |= bit_read(&bs, 6) << 5;
 			}
 
 			if (len) {
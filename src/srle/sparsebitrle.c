@@ -17,82 +17,86 @@ static uint8_t neededbits(uint8_t val) {
 	return bits;
 }
 
-static uint8_t store;
-static uint8_t storedbits;
-static uint8_t *bitout, *bitstart;
-static const uint8_t *bitin;
-
-static void bit_init_write(uint8_t *ptr) {
-	store = 0;
-	storedbits = 0;
-	bitstart = bitout = ptr;
+// Bit I/O state. It lives on the stack of the calling codec function,
+// so that several blocks can be (de)compressed in parallel.
+struct bitstate_t {
+	uint8_t store;
+	uint8_t storedbits;
+	uint8_t *bitout, *bitstart;
+	const uint8_t *bitin;
+};
+
+static void bit_init_write(struct bitstate_t *bs, uint8_t *ptr) {
+	bs->store = 0;
+	bs->storedbits = 0;
+	bs->bitstart = bs->bitout = ptr;
 }
 
-static void bit_init_read(const uint8_t *ptr) {
-	store = 0;
-	storedbits = 0;
-	bitin = ptr;
+static void bit_init_read(struct bitstate_t *bs, const uint8_t *ptr) {
+	bs->store = 0;
+	bs->storedbits = 0;
+	bs->bitin = ptr;
 }
 
-static uint16_t bit_flush() {
-	if (storedbits) {
-		*bitout++ = store >> (8 - storedbits);
-		storedbits = 0;
-		store = 0;
+static uint16_t bit_flush(struct bitstate_t *bs) {
+	if (bs->storedbits) {
+		*bs->bitout++ = bs->store >> (8 - bs->storedbits);
+		bs->storedbits = 0;
+		bs->store = 0;
 	}
 
-	return bitout - bitstart;
+	return bs->bitout - bs->bitstart;
 }
 
-static void bit_write(uint8_t val, uint8_t num) {
-	if (!storedbits && num == 8) {
-		*bitout++ = val;
+static void bit_write(struct bitstate_t *bs, uint8_t val, uint8_t num) {
+	if (!bs->storedbits && num == 8) {
+		*bs->bitout++ = val;
 		return;
 	}
 
 	while (num) {
-		store >>= 1;
-		store |= (val & 1) << 7;
+		bs->store >>= 1;
+		bs->store |= (val & 1) << 7;
 		val >>= 1;
 		num--;
-		storedbits++;
+		bs->storedbits++;
 
-		if (storedbits == 8) {
-			bit_flush();
+		if (bs->storedbits == 8) {
+			bit_flush(bs);
 		}
 	}
 }
 
-static uint8_t bit_read(uint8_t num) {
+static uint8_t bit_read(struct bitstate_t *bs, uint8_t num) {
 	uint8_t val = 0;
 
-	if (!storedbits) {
-		store = *bitin++;
-		storedbits = 8;
+	if (!bs->storedbits) {
+		bs->store = *bs->bitin++;
+		bs->storedbits = 8;
 	}
 
-	if (num == storedbits) {
-		storedbits = 0;
-		return store;
-	} else if (num < storedbits) {
-		val = store & ((1 << num) - 1);
-		storedbits -= num;
-		store >>= num;
+	if (num == bs->storedbits) {
+		bs->storedbits = 0;
+		return bs->store;
+	} else if (num < bs->storedbits) {
+		val = bs->store & ((1 << num) - 1);
+		bs->storedbits -= num;
+		bs->store >>= num;
 		return val;
 	} else {
 		const uint8_t num_mask = ((1 << num) - 1);
-		val = store;
-		num -= storedbits;
-		const uint8_t got = storedbits;
+		val = bs->store;
+		num -= bs->storedbits;
+		const uint8_t got = bs->storedbits;
 
-		store = *bitin++;
-		storedbits = 8;
+		bs->store = *bs->bitin++;
+		bs->storedbits = 8;
 
-		val |= store << got;
+		val |= bs->store << got;
 		val &= num_mask;
 
-		store >>= num;
-		storedbits -= num;
+		bs->store >>= num;
+		bs->storedbits -= num;
 		return val;
 	}
 }
@@ -103,6 +107,7 @@ uint16_t sparsebitrle_comp(const uint8_t *in, uint8_t *out, const uint16_t len)
 	uint8_t cur, hi;
 	uint8_t chr2pos[256] = { 0 };
 	uint8_t * const start = out;
+	struct bitstate_t bs;
 
 	if (len > 16384)
 		return USHRT_MAX;
@@ -142,7 +147,7 @@ uint16_t sparsebitrle_comp(const uint8_t *in, uint8_t *out, const uint16_t len)
 			*out++ = i;
 		}
 	}
-	bit_init_write(out);
+	bit_init_write(&bs, out);
 
 	cur = *in;
 	run = 1;
@@ -159,28 +164,28 @@ uint16_t sparsebitrle_comp(const uint8_t *in, uint8_t *out, const uint16_t len)
 				run++;
 
 			if (run == 1) {
-				bit_write(chr2pos[cur], bitlen);
+				bit_write(&bs, chr2pos[cur], bitlen);
 //				printf("byte %u\n", cur);
 			} else {
 				if (cur == 0) {
-					bit_write(run < 256 ? zero_short : zero_long, bitlen);
+					bit_write(&bs, run < 256 ? zero_short : zero_long, bitlen);
 					// Zero runs don't output the byte
 				} else {
-					bit_write(run < 256 ? run_short : run_long, bitlen);
-					bit_write(chr2pos[cur], bitlen);
+					bit_write(&bs, run < 256 ? run_short : run_long, bitlen);
+					bit_write(&bs, chr2pos[cur], bitlen);
 				}
 				if (run < 256) {
-					bit_write(run, 8);
+					bit_write(&bs, run, 8);
 //					printf("short run %u, %u\n", run, cur);
 				} else {
-					bit_write(run & 0xff, 8);
-					bit_write(run >> 8, 6);
+					bit_write(&bs, run & 0xff, 8);
+					bit_write(&bs, run >> 8, 6);
 //					printf("long run %u, %u\n", run, cur);
 				}
 			}
 
 			if (i == len - 1 && in[i] != cur)
-				bit_write(chr2pos[in[i]], bitlen);
+				bit_write(&bs, chr2pos[in[i]], bitlen);
 
 			run = 1;
 			cur = in[i];
@@ -189,7 +194,7 @@ uint16_t sparsebitrle_comp(const uint8_t *in, uint8_t *out, const uint16_t len)
 		}
 	}
 
-	out += bit_flush();
+	out += bit_flush(&bs);
 
 	return out - start;
 }
@@ -197,6 +202,7 @@ uint16_t sparsebitrle_comp(const uint8_t *in, uint8_t *out, const uint16_t len)
 void sparsebitrle_decomp(const uint8_t *in, uint8_t *out, const uint16_t outlen) {
 //uint8_t * const outstart = out;
 	const uint8_t * const end = out + outlen;
+	struct bitstate_t bs;
 	const uint8_t numvals = *in++;
 	const uint8_t * const valtab = in;
 	in += numvals;
@@ -207,26 +213,26 @@ void sparsebitrle_decomp(const uint8_t *in, uint8_t *out, const uint16_t outlen)
 	const uint8_t run_long = numvals + 3;
 	const uint8_t bitlen = neededbits(run_long);
 
-	bit_init_read(in);
+	bit_init_read(&bs, in);
 
 	while (out < end) {
-		uint8_t val = bit_read(bitlen);
+		uint8_t val = bit_read(&bs, bitlen);
 		uint8_t src = 0;
 
 		if (val < zero_short) {
 			*out++ = valtab[val];
 		} else if (val > zero_long) {
-			src = valtab[bit_read(bitlen)];
+			src = valtab[bit_read(&bs, bitlen)];
 		}
 
 		uint16_t len;
 		if (val == zero_short || val == run_short) {
-			len = bit_read(8);
+			len = bit_read(&bs, 8);
 			memset(out, src, len);
 			out += len;
 		} else if (val == zero_long || val == run_long) {
-			len = bit_read(8);
-			len |= bit_read(6) << 8;
+			len = bit_read(&bs, 8);
+			len |= bit_read(&bs, 6) << 8;
 			if (!len)
 				len = 1 << 14;
 
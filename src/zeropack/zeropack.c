@@ -71,82 +71,86 @@ static uint8_t neededbits(uint8_t val) {
 	return bits;
 }
 
-static uint8_t store;
-static uint8_t storedbits;
-static uint8_t *bitout, *bitstart;
-static const uint8_t *bitin;
-
-static void bit_init_write(uint8_t *ptr) {
-	store = 0;
-	storedbits = 0;
-	bitstart = bitout = ptr;
+// Bit I/O state. It lives on the stack of the calling codec function,
+// so that several blocks can be (de)compressed in parallel.
+struct bitstate_t {
+	uint8_t store;
+	uint8_t storedbits;
+	uint8_t *bitout, *bitstart;
+	const uint8_t *bitin;
+};
+
+static void bit_init_write(struct bitstate_t *bs, uint8_t *ptr) {
+	bs->store = 0;
+	bs->storedbits = 0;
+	bs->bitstart = bs->bitout = ptr;
 }
 
-static void bit_init_read(const uint8_t *ptr) {
-	store = 0;
-	storedbits = 0;
-	bitin = ptr;
+static void bit_init_read(struct bitstate_t *bs, const uint8_t *ptr) {
+	bs->store = 0;
+	bs->storedbits = 0;
+	bs->bitin = ptr;
 }
 
-static uint16_t bit_flush() {
-	if (storedbits) {
-		*bitout++ = store >> (8 - storedbits);
-		storedbits = 0;
-		store = 0;
+static uint16_t bit_flush(struct bitstate_t *bs) {
+	if (bs->storedbits) {
+		*bs->bitout++ = bs->store >> (8 - bs->storedbits);
+		bs->storedbits = 0;
+		bs->store = 0;
 	}
 
-	return bitout - bitstart;
+	return bs->bitout - bs->bitstart;
 }
 
-static void bit_write(uint8_t val, uint8_t num) {
-	if (!storedbits && num == 8) {
-		*bitout++ = val;
+static void bit_write(struct bitstate_t *bs, uint8_t val, uint8_t num) {
+	if (!bs->storedbits && num == 8) {
+		*bs->bitout++ = val;
 		return;
 	}
 
 	while (num) {
-		store >>= 1;
-		store |= (val & 1) << 7;
+		bs->store >>= 1;
+		bs->store |= (val & 1) << 7;
 		val >>= 1;
 		num--;
-		storedbits++;
+		bs->storedbits++;
 
-		if (storedbits == 8) {
-			bit_flush();
+		if (bs->storedbits == 8) {
+			bit_flush(bs);
 		}
 	}
 }
 
-static uint8_t bit_read(uint8_t num) {
+static uint8_t bit_read(struct bitstate_t *bs, uint8_t num) {
 	uint8_t val = 0;
 
-	if (!storedbits) {
-		store = *bitin++;
-		storedbits = 8;
+	if (!bs->storedbits) {
+		bs->store = *bs->bitin++;
+		bs->storedbits = 8;
 	}
 
-	if (num == storedbits) {
-		storedbits = 0;
-		return store;
-	} else if (num < storedbits) {
-		val = store & ((1 << num) - 1);
-		storedbits -= num;
-		store >>= num;
+	if (num == bs->storedbits) {
+		bs->storedbits = 0;
+		return bs->store;
+	} else if (num < bs->storedbits) {
+		val = bs->store & ((1 << num) - 1);
+		bs->storedbits -= num;
+		bs->store >>= num;
 		return val;
 	} else {
 		const uint8_t num_mask = ((1 << num) - 1);
-		val = store;
-		num -= storedbits;
-		const uint8_t got = storedbits;
+		val = bs->store;
+		num -= bs->storedbits;
+		const uint8_t got = bs->storedbits;
 
-		store = *bitin++;
-		storedbits = 8;
+		bs->store = *bs->bitin++;
+		bs->storedbits = 8;
 
-		val |= store << got;
+		val |= bs->store << got;
 		val &= num_mask;
 
-		store >>= num;
-		storedbits -= num;
+		bs->store >>= num;
+		bs->storedbits -= num;
 		return val;
 	}
 }
@@ -189,6 +193,7 @@ uint16_t zeropack_comp_rec(const uint8_t *in, uint8_t *out, const uint16_t len)
 	uint8_t level;
 	uint8_t buf[len], buf2[MAXLEVELS][len / 8];
 	uint8_t * const start = out;
+	struct bitstate_t bs;
 	uint16_t sizes[MAXLEVELS], bitsizes[MAXLEVELS];
 
 	const uint16_t size0 = sizes[0] = zeropack_comp(in, buf, len);
@@ -278,17 +283,17 @@ uint16_t zeropack_comp_rec(const uint8_t *in, uint8_t *out, const uint16_t len)
 	*out++ = usedvals;
 	*out++ = neededbits(largest);
 
-	bit_init_write(out);
+	bit_init_write(&bs, out);
 
 	for (i = 0; i < usedvals; i++)
-		bit_write(nodes[i].sym, neededbits(largest));
+		bit_write(&bs, nodes[i].sym, neededbits(largest));
 
-	bit_write(longestbit, 4);
+	bit_write(&bs, longestbit, 4);
 
 	for (i = 1; i <= longestbit; i++) {
 		if (canon[i] >= 16)
 			return USHRT_MAX;
-		bit_write(canon[i], 4);
+		bit_write(&bs, canon[i], 4);
 	}
 
 	for (i = 0; i < num; i++) {
@@ -303,17 +308,17 @@ uint16_t zeropack_comp_rec(const uint8_t *in, uint8_t *out, const uint16_t len)
 
 		while (bits) {
 			const u8 step = bits < 8 ? bits : 8;
-			bit_write(val & 0xff, step);
+			bit_write(&bs, val & 0xff, step);
 			bits -= step;
 			val >>= step;
 		}
 	}
 
 	// Padding for the reader speed
-	bit_write(0, 8);
-	bit_write(0, 8);
+	bit_write(&bs, 0, 8);
+	bit_write(&bs, 0, 8);
 
-	out += bit_flush();
+	out += bit_flush(&bs);
 	return out - start;
 }
 
@@ -331,24 +336,30 @@ static uint16_t ipow(uint16_t base, uint16_t exp) {
 	return out;
 }*/
 
-static u8 huffbytes[MAXUSED];
-static u16 huffstate;
-static u8 hsbits;
-static u8 hsused;
-static u16 hsand[MAXUSED];
-static u8 hslen[MAXUSED];
+static const uint16_t pow8[MAXLEVELS] = { 1, 8, 64, 512 };
 
-// partial accel table
-static u8 habyte[32];
-static u8 habits[32];
-static u8 hastart;
+// Decoder state, kept on the stack of zeropack_decomp_rec
+struct zpstate_t {
+	struct bitstate_t bs;
 
-static const uint16_t pow8[MAXLEVELS] = { 1, 8, 64, 512 };
-static uint16_t canoncodes[MAXUSED] = { 0 };
-static const uint8_t *bytepos[MAXLEVELS];
+	u8 huffbytes[MAXUSED];
+	u16 huffstate;
+	u8 hsbits;
+	u8 hsused;
+	u16 hsand[MAXUSED];
+	u8 hslen[MAXUSED];
+
+	// partial accel table
+	u8 habyte[32];
+	u8 habits[32];
+	u8 hastart;
+
+	uint16_t canoncodes[MAXUSED];
+	const uint8_t *bytepos[MAXLEVELS];
+};
 
 #define REC(level, levelminus) \
-static uint16_t inner_rec ## level(const uint8_t val, uint8_t *out) { \
+static uint16_t inner_rec ## level(struct zpstate_t *zs, const uint8_t val, uint8_t *out) { \
 \
 	const uint16_t num = pow8[level]; \
 	uint8_t i; \
@@ -356,8 +367,8 @@ static uint16_t inner_rec ## level(const uint8_t val, uint8_t *out) { \
 	uint16_t wrote = 0; \
 	for (i = 0; i < 8; i++) { \
 		if (val & (1 << i)) { \
-			const uint16_t got = inner_rec ## levelminus(*bytepos[level]++, \
-							out); \
+			const uint16_t got = inner_rec ## levelminus(zs, \
+							*zs->bytepos[level]++, out); \
 			if (got != num) { \
 				/*printf("err, wrote %u expected %u\n", got, num);*/ \
 				abort(); \
@@ -374,49 +385,49 @@ static uint16_t inner_rec ## level(const uint8_t val, uint8_t *out) { \
 	return wrote; \
 }
 
-static uint8_t gethuff() {
+static uint8_t gethuff(struct zpstate_t *zs) {
 	uint8_t out = 0;
 
 	// Read bits until we have a huff match
-	if (!hsbits) {
-		huffstate = bit_read(8);
-		huffstate |= bit_read(8) << 8;
-		hsbits = 16;
-	} else if (hsbits < 8) {
-		huffstate |= bit_read(8) << hsbits;
-		hsbits += 8;
+	if (!zs->hsbits) {
+		zs->huffstate = bit_read(&zs->bs, 8);
+		zs->huffstate |= bit_read(&zs->bs, 8) << 8;
+		zs->hsbits = 16;
+	} else if (zs->hsbits < 8) {
+		zs->huffstate |= bit_read(&zs->bs, 8) << zs->hsbits;
+		zs->hsbits += 8;
 	}
 
 	u8 h;
 
-	h = huffstate & 0x1f;
-	if (habits[h]) {
-		hsbits -= habits[h];
-		huffstate >>= habits[h];
-		return habyte[h];
+	h = zs->huffstate & 0x1f;
+	if (zs->habits[h]) {
+		zs->hsbits -= zs->habits[h];
+		zs->huffstate >>= zs->habits[h];
+		return zs->habyte[h];
 	}
 
-	for (h = hastart; h < hsused; h++) {
-		while (hslen[h] > hsbits) {
-			if (hsbits <= 8) {
-				huffstate |= bit_read(8) << hsbits;
-				hsbits += 8;
-			} else if (hsbits <= 12) {
-				huffstate |= bit_read(4) << hsbits;
-				hsbits += 4;
+	for (h = zs->hastart; h < zs->hsused; h++) {
+		while (zs->hslen[h] > zs->hsbits) {
+			if (zs->hsbits <= 8) {
+				zs->huffstate |= bit_read(&zs->bs, 8) << zs->hsbits;
+				zs->hsbits += 8;
+			} else if (zs->hsbits <= 12) {
+				zs->huffstate |= bit_read(&zs->bs, 4) << zs->hsbits;
+				zs->hsbits += 4;
 			} else {
-				huffstate |= bit_read(1) << hsbits;
-				hsbits++;
+				zs->huffstate |= bit_read(&zs->bs, 1) << zs->hsbits;
+				zs->hsbits++;
 			}
 		}
-		if ((huffstate & hsand[h]) == canoncodes[h]) {
-			out = huffbytes[h];
-			hsbits -= hslen[h];
-			huffstate >>= hslen[h];
+		if ((zs->huffstate & zs->hsand[h]) == zs->canoncodes[h]) {
+			out = zs->huffbytes[h];
+			zs->hsbits -= zs->hslen[h];
+			zs->huffstate >>= zs->hslen[h];
 			break;
 		}
 	}
-	if (h == hsused) {
+	if (h == zs->hsused) {
 //		printf("err, not found\n");
 		abort();
 	}
@@ -424,7 +435,7 @@ static uint8_t gethuff() {
 	return out;
 }
 
-static uint16_t inner_rec0(const uint8_t val, uint8_t *out) {
+static uint16_t inner_rec0(struct zpstate_t *zs, const uint8_t val, uint8_t *out) {
 
 	uint64_t v = 0;
 
@@ -468,10 +479,10 @@ static uint16_t inner_rec0(const uint8_t val, uint8_t *out) {
 	goto *jmp[val & 0xf];
 
 #define LOW(b) \
-	if (b & (1 << 0)) v |= (uint64_t) gethuff() << 0 * 8; \
-	if (b & (1 << 1)) v |= (uint64_t) gethuff() << 1 * 8; \
-	if (b & (1 << 2)) v |= (uint64_t) gethuff() << 2 * 8; \
-	if (b & (1 << 3)) v |= (uint64_t) gethuff() << 3 * 8;
+	if (b & (1 << 0)) v |= (uint64_t) gethuff(zs) << 0 * 8; \
+	if (b & (1 << 1)) v |= (uint64_t) gethuff(zs) << 1 * 8; \
+	if (b & (1 << 2)) v |= (uint64_t) gethuff(zs) << 2 * 8; \
+	if (b & (1 << 3)) v |= (uint64_t) gethuff(zs) << 3 * 8;
 
 #define ENTRY(e) low ## e: LOW(e) goto next;
 
@@ -499,10 +510,10 @@ next:
 	goto *jmp2[val >> 4];
 
 #define HI(b) \
-	if (b & (1 << 0)) v |= (uint64_t) gethuff() << 4 * 8; \
-	if (b & (1 << 1)) v |= (uint64_t) gethuff() << 5 * 8; \
-	if (b & (1 << 2)) v |= (uint64_t) gethuff() << 6 * 8; \
-	if (b & (1 << 3)) v |= (uint64_t) gethuff() << 7 * 8;
+	if (b & (1 << 0)) v |= (uint64_t) gethuff(zs) << 4 * 8; \
+	if (b & (1 << 1)) v |= (uint64_t) gethuff(zs) << 5 * 8; \
+	if (b & (1 << 2)) v |= (uint64_t) gethuff(zs) << 6 * 8; \
+	if (b & (1 << 3)) v |= (uint64_t) gethuff(zs) << 7 * 8;
 
 #define ENTRY(e) hi ## e: HI(e) goto out;
 
@@ -543,7 +554,7 @@ REC(1, 0)
 REC(2, 1)
 REC(3, 2)
 
-static uint16_t (* const inner_recs[MAXLEVELS])(const uint8_t val, uint8_t *out) = {
+static uint16_t (* const inner_recs[MAXLEVELS])(struct zpstate_t *zs, const uint8_t val, uint8_t *out) = {
 	inner_rec0,
 	inner_rec1,
 	inner_rec2,
@@ -564,6 +575,7 @@ static uint8_t popcount8(uint8_t in) {
 void zeropack_decomp_rec(const uint8_t *in, uint8_t *out, const uint16_t outlen) {
 	const uint8_t level = *in++;
 	const uint8_t * const outstart = out;
+	struct zpstate_t state, * const zs = &state;
 	int8_t k;
 
 	uint16_t bytes[MAXLEVELS], bitsizes[MAXLEVELS], i;
@@ -579,60 +591,60 @@ void zeropack_decomp_rec(const uint8_t *in, uint8_t *out, const uint16_t outlen)
 		bytes[level] += popcount8(ptr[i]);
 	}
 	ptr += bitsizes[level];
-	bytepos[level] = ptr;
+	zs->bytepos[level] = ptr;
 
 	for (k = level - 1; k > 0; k--) {
 		bytes[k] = 0;
 		for (i = 0; i < bytes[k + 1]; i++) {
 			bytes[k] += popcount8(*ptr++);
 		}
-		bytepos[k] = ptr;
+		zs->bytepos[k] = ptr;
 	}
 	if (level)
-		bytepos[0] = ptr + bytes[1];
+		zs->bytepos[0] = ptr + bytes[1];
 
-	const u8 usedvals = hsused = *bytepos[0]++;
-	const u8 valbits = *bytepos[0]++;
-	bit_init_read(bytepos[0]);
+	const u8 usedvals = zs->hsused = *zs->bytepos[0]++;
+	const u8 valbits = *zs->bytepos[0]++;
+	bit_init_read(&zs->bs, zs->bytepos[0]);
 
 	for (i = 0; i < usedvals; i++)
-		huffbytes[i] = bit_read(valbits);
+		zs->huffbytes[i] = bit_read(&zs->bs, valbits);
 
-	const u8 longestbit = bit_read(4);
+	const u8 longestbit = bit_read(&zs->bs, 4);
 	u8 canonlen[16] = { 0 };
 	for (i = 1; i <= longestbit; i++)
-		canonlen[i] = bit_read(4);
+		canonlen[i] = bit_read(&zs->bs, 4);
 
 	for (i = 0; i < usedvals; i++) {
 		u32 val, bits;
 		canoncode(i, canonlen, &val, &bits);
-		canoncodes[i] = bitreverse(val, bits);
-		hsand[i] = (1 << bits) - 1;
-		hslen[i] = bits;
+		zs->canoncodes[i] = bitreverse(val, bits);
+		zs->hsand[i] = (1 << bits) - 1;
+		zs->hslen[i] = bits;
 
-//		printf("Canoncode %u %u: %#04x, len %u, and %#04x\n", i, huffbytes[i],
-//			canoncodes[i],
-//			hslen[i], hsand[i]);
+//		printf("Canoncode %u %u: %#04x, len %u, and %#04x\n", i, zs->huffbytes[i],
+//			zs->canoncodes[i],
+//			zs->hslen[i], zs->hsand[i]);
 	}
 
-	memset(habits, 0, 32);
-	hastart = 0;
+	memset(zs->habits, 0, 32);
+	zs->hastart = 0;
 	for (i = 0; i < 32; i++) {
 		uint8_t h;
-		for (h = 0; h < hsused; h++) {
-			if (hslen[h] > 5) {
-				hastart = h;
+		for (h = 0; h < zs->hsused; h++) {
+			if (zs->hslen[h] > 5) {
+				zs->hastart = h;
 				break;
 			}
-			if ((i & hsand[h]) == canoncodes[h]) {
-				habyte[i] = huffbytes[h];
-				habits[i] = hslen[h];
+			if ((i & zs->hsand[h]) == zs->canoncodes[h]) {
+				zs->habyte[i] = zs->huffbytes[h];
+				zs->habits[i] = zs->hslen[h];
 				break;
 			}
 		}
 	}
 
-	huffstate = hsbits = 0;
+	zs->huffstate = zs->hsbits = 0;
 
 	// Recursively unpack, straight to dest
 	const uint16_t num = pow8[level] * 8;
@@ -641,7 +653,7 @@ void zeropack_decomp_rec(const uint8_t *in, uint8_t *out, const uint16_t outlen)
 			memset(out, 0, num);
 			out += num;
 		} else {
-			out += inner_recs[level](in[i], out);
+			out += inner_recs[level](zs, in[i], out);
 		}
 	}
 